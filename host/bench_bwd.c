@@ -0,0 +1,311 @@
+// Micro-benchmarks for the bitmap kernels in bwd.c and
+// bitmap_transform.c, run on the host
+// against the real resources/*.rle and *.atlas files.  See the Makefile for how
+// to build and run this.
+//
+// bench_bwd [-c] [-t ms]
+//
+//   -c     Print only the checksum of each decoded bitmap, suitable
+//          for diffing against a previous run to prove a change to
+//          the decoder is bit-identical.
+//   -t ms  Target time for each measurement round (default 100).
+
+#include <pebble.h>
+#include <getopt.h>
+#include "bwd.h"
+#include "bitmap_transform.h"
+#include "sprite_atlas.h"
+
+// An rle image: either a whole .rle resource, or one image of an
+// atlas, whose offset and size are filled in by bench_locate().
+typedef struct {
+  const char *name;
+  int resource_id;
+  int image;      // The image within the atlas, or -1.
+  size_t offset;  // The image's offset within the resource.
+  size_t size;    // The image's size in bytes.
+} BenchResource;
+
+static BenchResource bench_faces[] = {
+  { "twelve", RESOURCE_ID_TWELVE, -1 },
+  { "one", RESOURCE_ID_ONE, -1 },
+  { "two", RESOURCE_ID_TWO, -1 },
+  { "three", RESOURCE_ID_THREE, -1 },
+  { "four", RESOURCE_ID_FOUR, -1 },
+  { "five", RESOURCE_ID_FIVE, -1 },
+  { "six", RESOURCE_ID_SIX, -1 },
+  { "seven", RESOURCE_ID_SEVEN, -1 },
+  { "eight", RESOURCE_ID_EIGHT, -1 },
+  { "nine", RESOURCE_ID_NINE, -1 },
+  { "ten", RESOURCE_ID_TEN, -1 },
+  { "eleven", RESOURCE_ID_ELEVEN, -1 },
+  { "hurt", RESOURCE_ID_HURT, -1 },
+};
+#define NUM_BENCH_FACES (sizeof(bench_faces) / sizeof(bench_faces[0]))
+
+// The images of the atlases are in the order make_rle.py -a writes
+// them: the mask, then the frames; then the same again, mirrored.
+static BenchResource bench_sprites[] = {
+  { "tardis_mask", RESOURCE_ID_TARDIS_ATLAS, 0 },
+  { "tardis_01", RESOURCE_ID_TARDIS_ATLAS, 1 },
+  { "tardis_02", RESOURCE_ID_TARDIS_ATLAS, 2 },
+  { "tardis_03", RESOURCE_ID_TARDIS_ATLAS, 3 },
+  { "tardis_04", RESOURCE_ID_TARDIS_ATLAS, 4 },
+  { "k9", RESOURCE_ID_K9_ATLAS, 1 },
+  { "k9_mask", RESOURCE_ID_K9_ATLAS, 0 },
+  { "dalek", RESOURCE_ID_DALEK_ATLAS, 1 },
+  { "dalek_mask", RESOURCE_ID_DALEK_ATLAS, 0 },
+  { "k9_x", RESOURCE_ID_K9_ATLAS, 3 },
+  { "k9_mask_x", RESOURCE_ID_K9_ATLAS, 2 },
+  { "dalek_x", RESOURCE_ID_DALEK_ATLAS, 3 },
+  { "dalek_mask_x", RESOURCE_ID_DALEK_ATLAS, 2 },
+  { "mins_background", RESOURCE_ID_MINS_BACKGROUND, -1 },
+};
+#define NUM_BENCH_SPRITES (sizeof(bench_sprites) / sizeof(bench_sprites[0]))
+
+// Number of rounds per measurement; we report the fastest.
+#define BENCH_ROUNDS 5
+
+static double target_ns = 100e6;
+static volatile unsigned long bench_sink;
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// The result of timing one kernel on one input.
+typedef struct {
+  double ns_per_call;
+  double allocs_per_call;
+} BenchResult;
+
+typedef void BenchFunc(const BenchResource *res);
+
+// Calls func(res) repeatedly, first to find an iteration count that
+// takes about target_ns, then for BENCH_ROUNDS rounds of that many
+// iterations.  Returns the best round.
+static BenchResult run_bench(BenchFunc *func, const BenchResource *res) {
+  // Warm up (and load the resource into memory).
+  func(res);
+
+  long iterations = 1;
+  while (true) {
+    double start = now_ns();
+    for (long i = 0; i < iterations; ++i) {
+      func(res);
+    }
+    double elapsed = now_ns() - start;
+    if (elapsed >= target_ns / 10 || iterations >= (1L << 30)) {
+      iterations = (long)(iterations * (target_ns / (elapsed + 1)));
+      if (iterations < 1) {
+        iterations = 1;
+      }
+      break;
+    }
+    iterations *= 2;
+  }
+
+  BenchResult best;
+  best.ns_per_call = 0.0;
+  best.allocs_per_call = 0.0;
+  for (int round = 0; round < BENCH_ROUNDS; ++round) {
+    unsigned long allocs_before = host_heap_stats.allocs;
+    double start = now_ns();
+    for (long i = 0; i < iterations; ++i) {
+      func(res);
+    }
+    double ns = (now_ns() - start) / iterations;
+    if (round == 0 || ns < best.ns_per_call) {
+      best.ns_per_call = ns;
+    }
+    best.allocs_per_call = (double)(host_heap_stats.allocs - allocs_before) / iterations;
+  }
+  return best;
+}
+
+// Fills in the offset and size of each image.
+static void bench_locate(BenchResource *resources, size_t num_resources) {
+  for (size_t i = 0; i < num_resources; ++i) {
+    BenchResource *res = &resources[i];
+    size_t resource_bytes = resource_size(resource_get_handle(res->resource_id));
+    res->offset = 0;
+    res->size = resource_bytes;
+    if (res->image >= 0) {
+      SpriteAtlas atlas;
+      sprite_atlas_init(&atlas, res->resource_id);
+      res->offset = atlas.offsets[res->image];
+      size_t end = (res->image + 1 < atlas.num_images) ? atlas.offsets[res->image + 1] : resource_bytes;
+      res->size = end - res->offset;
+    }
+  }
+}
+
+// FNV-1a over the visible rows of a decoded bitmap.
+static uint32_t bitmap_checksum(GBitmap *bitmap) {
+  uint32_t hash = 2166136261u;
+  int width_bytes = (bitmap->bounds.size.w + 7) / 8;
+  for (int y = 0; y < bitmap->bounds.size.h; ++y) {
+    uint8_t *row = (uint8_t *)bitmap->addr + y * bitmap->row_size_bytes;
+    for (int x = 0; x < width_bytes; ++x) {
+      hash = (hash ^ row[x]) * 16777619u;
+    }
+  }
+  return hash;
+}
+
+static void bench_rle_bwd_create(const BenchResource *res) {
+  BitmapWithData bwd = rle_bwd_create_offset(res->resource_id, res->offset);
+  bench_sink += bwd.data[sizeof(BitmapDataHeader)];
+  bwd_destroy(&bwd);
+}
+
+static void bench_rl2unpacker_getc(const BenchResource *res) {
+  RleHeader header;
+  rle_header_init_offset(res->resource_id, res->offset, &header);
+  RBuffer rb;
+  rbuffer_init_offset(res->resource_id, &rb, header.data_start);
+
+  Rl2Unpacker rl2;
+  rl2unpacker_init(&rl2, &rb, header.n);
+  unsigned long total = 0;
+  // Stop at the end of the image, rather than reading on into the
+  // next one of an atlas.
+  size_t end = res->offset + res->size;
+  int count = rl2unpacker_getc(&rl2);
+  while (count != EOF && rb._bytes_read - rb._filled_size + rb._i <= end) {
+    total += count;
+    count = rl2unpacker_getc(&rl2);
+  }
+  rbuffer_deinit(&rb);
+  bench_sink += total;
+}
+
+static void bench_rbuffer_getc(const BenchResource *res) {
+  RBuffer rb;
+  rbuffer_init_offset(res->resource_id, &rb, res->offset);
+  unsigned long total = 0;
+  for (size_t i = 0; i < res->size; ++i) {
+    total += rbuffer_getc(&rb);
+  }
+  rbuffer_deinit(&rb);
+  bench_sink += total;
+}
+
+// The transforms work in-place, so they are timed on a bitmap
+// decoded once up front; an even number of flips leaves it unchanged.
+static BitmapWithData flip_source;
+
+static void bench_bitmap_flip_x(const BenchResource *res) {
+  bitmap_flip_x(flip_source.bitmap);
+}
+
+static void bench_bitmap_shift_x(const BenchResource *res) {
+  bitmap_shift_x(flip_source.bitmap, 13);
+}
+
+static void bench_bwd_crop(const BenchResource *res) {
+  GBitmap *bitmap = flip_source.bitmap;
+  BitmapWithData crop = bwd_crop(bitmap, GRect(5, 0, bitmap->bounds.size.w - 10, bitmap->bounds.size.h));
+  bwd_destroy(&crop);
+}
+
+static void bench_reverse_bits(const BenchResource *res) {
+  unsigned long total = 0;
+  for (int b = 0; b < 256; ++b) {
+    total += reverse_bits((uint8_t)b);
+  }
+  bench_sink += total;
+}
+
+static void print_checksums(const BenchResource *resources, size_t num_resources) {
+  for (size_t i = 0; i < num_resources; ++i) {
+    BitmapWithData bwd = rle_bwd_create_offset(resources[i].resource_id, resources[i].offset);
+    printf("%-16s %3dx%-3d %08x\n", resources[i].name,
+           bwd.bitmap->bounds.size.w, bwd.bitmap->bounds.size.h,
+           bitmap_checksum(bwd.bitmap));
+    bwd_destroy(&bwd);
+  }
+}
+
+static void report_decode(const BenchResource *resources, size_t num_resources) {
+  for (size_t i = 0; i < num_resources; ++i) {
+    const BenchResource *res = &resources[i];
+    BitmapWithData bwd = rle_bwd_create_offset(res->resource_id, res->offset);
+    size_t out_bytes = bwd.bitmap->row_size_bytes * bwd.bitmap->bounds.size.h;
+    uint32_t checksum = bitmap_checksum(bwd.bitmap);
+    bwd_destroy(&bwd);
+    size_t in_bytes = res->size;
+
+    BenchResult decode = run_bench(&bench_rle_bwd_create, res);
+    BenchResult runs = run_bench(&bench_rl2unpacker_getc, res);
+    BenchResult bytes = run_bench(&bench_rbuffer_getc, res);
+
+    printf("%-16s %6zu %6zu %10.0f %9.1f %7.2f %10.0f %10.0f  %08x\n",
+           res->name, in_bytes, out_bytes,
+           decode.ns_per_call, out_bytes / decode.ns_per_call * 1000.0,
+           decode.allocs_per_call, runs.ns_per_call, bytes.ns_per_call,
+           checksum);
+  }
+}
+
+static void report_transform(const BenchResource *resources, size_t num_resources) {
+  for (size_t i = 0; i < num_resources; ++i) {
+    const BenchResource *res = &resources[i];
+    flip_source = rle_bwd_create_offset(res->resource_id, res->offset);
+    BenchResult flip = run_bench(&bench_bitmap_flip_x, res);
+    BenchResult crop = run_bench(&bench_bwd_crop, res);
+    BenchResult shift = run_bench(&bench_bitmap_shift_x, res);
+    printf("%-16s %3dx%-3d %10.0f %10.0f %7.2f %10.0f\n", res->name,
+           flip_source.bitmap->bounds.size.w, flip_source.bitmap->bounds.size.h,
+           flip.ns_per_call, crop.ns_per_call, crop.allocs_per_call, shift.ns_per_call);
+    bwd_destroy(&flip_source);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  bool checksums_only = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "ct:")) != -1) {
+    switch (opt) {
+    case 'c':
+      checksums_only = true;
+      break;
+    case 't':
+      target_ns = atof(optarg) * 1e6;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-c] [-t ms]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  bench_locate(bench_faces, NUM_BENCH_FACES);
+  bench_locate(bench_sprites, NUM_BENCH_SPRITES);
+
+  if (checksums_only) {
+    print_checksums(bench_faces, NUM_BENCH_FACES);
+    print_checksums(bench_sprites, NUM_BENCH_SPRITES);
+    return 0;
+  }
+
+  printf("rle_bwd_create: ns per call, decoded MB/s and allocations per call;\n");
+  printf("rl2unpacker_getc and rbuffer_getc: ns per full pass over the resource.\n\n");
+  printf("%-16s %6s %6s %10s %9s %7s %10s %10s  %s\n",
+         "resource", "in", "out", "ns/decode", "MB/s", "allocs",
+         "ns/runs", "ns/bytes", "checksum");
+  report_decode(bench_faces, NUM_BENCH_FACES);
+  report_decode(bench_sprites, NUM_BENCH_SPRITES);
+
+  printf("\nbitmap_flip_x, bwd_crop and bitmap_shift_x: ns per call\n\n");
+  printf("%-16s %7s %10s %10s %7s %10s\n", "resource", "size", "ns/flip",
+         "ns/crop", "allocs", "ns/shift");
+  report_transform(bench_sprites, NUM_BENCH_SPRITES);
+
+  BenchResult reverse = run_bench(&bench_reverse_bits, NULL);
+  printf("\nreverse_bits: %.2f ns per byte\n", reverse.ns_per_call / 256);
+
+  return 0;
+}
@@ -0,0 +1,283 @@
+// Benchmarks the single-pass wipe compositor in compositor.c against
+// the multi-pass path it replaces, which draws each layer of a wipe
+// frame over the last with graphics_draw_bitmap_in_rect(), and checks
+// that both produce the same framebuffer for every frame.  See the
+// Makefile for how to build and run this.
+//
+// bench_compositor [-t ms]
+//
+//   -t ms  Target time for each measurement (default 100).
+//
+// The multi-pass path is timed against pebble_host.c's pixel-at-a-time
+// model of the firmware blitter, so its absolute numbers say little
+// about the watch; the point is the comparison of work per frame, and
+// the equivalence check.
+
+#include <pebble.h>
+#include <getopt.h>
+#include "bwd.h"
+#include "compositor.h"
+#include "sprite_atlas.h"
+
+#define SCREEN_WIDTH 144
+#define SCREEN_HEIGHT 168
+#define SCREEN_RECT GRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT)
+#define MINS_CARD_RECT GRect(SCREEN_WIDTH - 50, SCREEN_HEIGHT - 31, 50, 31)
+#define NUM_TRANSITION_FRAMES_HOUR 24
+
+// The sprites to wipe with, from their atlases as in doctors.c, which
+// also give their horizontal centers.  The Tardis is animated, so it
+// is represented by its mask alone; the others face the way they are
+// going, mirrored for a wipe from the left.
+typedef struct {
+  const char *name;
+  int atlas_id;
+  bool with_sprite;
+  bool wipe_direction;
+} BenchSprite;
+
+static const BenchSprite bench_sprites[] = {
+  { "tardis", RESOURCE_ID_TARDIS_ATLAS, false, false },
+  { "k9", RESOURCE_ID_K9_ATLAS, true, false },
+  { "k9_x", RESOURCE_ID_K9_ATLAS, true, true },
+  { "dalek", RESOURCE_ID_DALEK_ATLAS, true, false },
+  { "dalek_x", RESOURCE_ID_DALEK_ATLAS, true, true },
+};
+#define NUM_BENCH_SPRITES (sizeof(bench_sprites) / sizeof(bench_sprites[0]))
+
+static double target_ns = 100e6;
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// The state of one wipe: the layers of every frame.
+typedef struct {
+  BitmapWithData prev;
+  BitmapWithData face;
+  BitmapWithData mask;
+  BitmapWithData sprite;
+  BitmapWithData card;
+  WipeLayers frames[NUM_TRANSITION_FRAMES_HOUR + 1];
+} BenchWipe;
+
+// Fills in the layers of each frame the same way
+// face_layer_update_callback() does.
+static void bench_wipe_init(BenchWipe *wipe, const BenchSprite *bs) {
+  wipe->prev = rle_bwd_create(RESOURCE_ID_ELEVEN);
+  wipe->face = rle_bwd_create(RESOURCE_ID_TWELVE);
+  SpriteAtlas atlas;
+  sprite_atlas_init(&atlas, bs->atlas_id);
+  const AtlasFacing *facing = sprite_atlas_facing(&atlas, bs->wipe_direction);
+  int cx = facing->cx;
+  wipe->mask = sprite_atlas_bwd_create(&atlas, facing->mask);
+  wipe->sprite = bs->with_sprite ? sprite_atlas_bwd_create(&atlas, facing->frames[0]) : (BitmapWithData){ NULL, NULL };
+  wipe->card = rle_bwd_create(RESOURCE_ID_MINS_BACKGROUND);
+
+  int sprite_width = wipe->mask.bitmap->bounds.size.w;
+  int wipe_width = SCREEN_WIDTH + sprite_width;
+  for (int ti = 0; ti <= NUM_TRANSITION_FRAMES_HOUR; ++ti) {
+    int wipe_x = wipe_width - ti * wipe_width / NUM_TRANSITION_FRAMES_HOUR;
+    if (bs->wipe_direction) {
+      wipe_x = wipe_width - wipe_x;
+    }
+    wipe_x = wipe_x - (sprite_width - cx);
+
+    WipeLayers *layers = &wipe->frames[ti];
+    layers->left = bs->wipe_direction ? wipe->face.bitmap : wipe->prev.bitmap;
+    layers->right = bs->wipe_direction ? wipe->prev.bitmap : wipe->face.bitmap;
+    layers->wipe_x = wipe_x;
+    layers->face_y0 = 0;
+    layers->sprite_mask = wipe->mask.bitmap;
+    layers->sprite = wipe->sprite.bitmap;
+    layers->sprite_box = GRect(wipe_x - cx, (SCREEN_HEIGHT - wipe->mask.bitmap->bounds.size.h) / 2,
+                               wipe->mask.bitmap->bounds.size.w, wipe->mask.bitmap->bounds.size.h);
+    layers->card = wipe->card.bitmap;
+    layers->card_box = MINS_CARD_RECT;
+  }
+}
+
+static void bench_wipe_deinit(BenchWipe *wipe) {
+  bwd_destroy(&wipe->prev);
+  bwd_destroy(&wipe->face);
+  bwd_destroy(&wipe->mask);
+  if (wipe->sprite.bitmap != NULL) {
+    bwd_destroy(&wipe->sprite);
+  }
+  bwd_destroy(&wipe->card);
+}
+
+// The multi-pass path, as draw_wipe_rect() in doctors.c.
+static void draw_bitmap_clipped(GContext *ctx, GBitmap *bitmap, GRect destination, GRect clip) {
+  grect_clip(&clip, &destination);
+  if (grect_is_empty(&clip)) {
+    return;
+  }
+  GBitmap sub = *bitmap;
+  sub.bounds.origin.x += clip.origin.x - destination.origin.x;
+  sub.bounds.origin.y += clip.origin.y - destination.origin.y;
+  sub.bounds.size = clip.size;
+  graphics_draw_bitmap_in_rect(ctx, &sub, clip);
+}
+
+static void draw_face_clipped(GContext *ctx, GBitmap *image, int face_y0, GRect area, GRect clip) {
+  grect_clip(&clip, &area);
+  if (grect_is_empty(&clip)) {
+    return;
+  }
+  if (image != NULL) {
+    graphics_context_set_compositing_mode(ctx, GCompOpAssign);
+    draw_bitmap_clipped(ctx, image, GRect(0, face_y0, SCREEN_WIDTH, image->bounds.size.h), clip);
+  } else {
+    graphics_context_set_fill_color(ctx, GColorBlack);
+    graphics_fill_rect(ctx, clip, 0, GCornerNone);
+  }
+}
+
+static void draw_wipe_rect(GContext *ctx, GRect clip, const WipeLayers *layers) {
+  GRect screen = SCREEN_RECT;
+  grect_clip(&clip, &screen);
+  if (grect_is_empty(&clip)) {
+    return;
+  }
+  int wipe_x = layers->wipe_x;
+  int left_w = (wipe_x < 0) ? 0 : (wipe_x > SCREEN_WIDTH) ? SCREEN_WIDTH : wipe_x;
+  draw_face_clipped(ctx, layers->left, layers->face_y0, GRect(0, 0, left_w, SCREEN_HEIGHT), clip);
+  draw_face_clipped(ctx, layers->right, layers->face_y0, GRect(left_w, 0, SCREEN_WIDTH - left_w, SCREEN_HEIGHT), clip);
+  graphics_context_set_compositing_mode(ctx, GCompOpClear);
+  draw_bitmap_clipped(ctx, layers->sprite_mask, layers->sprite_box, clip);
+  if (layers->sprite != NULL) {
+    graphics_context_set_compositing_mode(ctx, GCompOpOr);
+    draw_bitmap_clipped(ctx, layers->sprite, layers->sprite_box, clip);
+  }
+  graphics_context_set_compositing_mode(ctx, GCompOpOr);
+  draw_bitmap_clipped(ctx, layers->card, layers->card_box, clip);
+}
+
+static void compose_wipe_rect(GContext *ctx, GRect clip, const WipeLayers *layers) {
+  GRect screen = SCREEN_RECT;
+  grect_clip(&clip, &screen);
+  if (grect_is_empty(&clip)) {
+    return;
+  }
+  GBitmap *fb = graphics_capture_frame_buffer(ctx);
+  compose_wipe((uint8_t *)fb->addr, fb->row_size_bytes, clip, layers);
+  graphics_release_frame_buffer(ctx, fb);
+}
+
+typedef void WipeRectFunc(GContext *ctx, GRect clip, const WipeLayers *layers);
+
+static GRect grect_union(GRect a, GRect b) {
+  int x0 = (a.origin.x < b.origin.x) ? a.origin.x : b.origin.x;
+  int y0 = (a.origin.y < b.origin.y) ? a.origin.y : b.origin.y;
+  int ax1 = a.origin.x + a.size.w;
+  int bx1 = b.origin.x + b.size.w;
+  int ay1 = a.origin.y + a.size.h;
+  int by1 = b.origin.y + b.size.h;
+  int x1 = (ax1 > bx1) ? ax1 : bx1;
+  int y1 = (ay1 > by1) ? ay1 : by1;
+  return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+// Draws frame ti of the wipe, either the whole screen or just the
+// damage since frame ti - 1, as face_layer_update_callback() does.
+static void draw_frame(GContext *ctx, WipeRectFunc *func, const BenchWipe *wipe, int ti, bool damage_only) {
+  const WipeLayers *layers = &wipe->frames[ti];
+  if (!damage_only || ti == 0) {
+    func(ctx, SCREEN_RECT, layers);
+    return;
+  }
+  const WipeLayers *last = &wipe->frames[ti - 1];
+  int x0 = (last->wipe_x < layers->wipe_x) ? last->wipe_x : layers->wipe_x;
+  int x1 = (last->wipe_x < layers->wipe_x) ? layers->wipe_x : last->wipe_x;
+  func(ctx, GRect(x0, 0, x1 - x0, SCREEN_HEIGHT), layers);
+  func(ctx, grect_union(last->sprite_box, layers->sprite_box), layers);
+  func(ctx, MINS_CARD_RECT, layers);
+}
+
+// Returns the mean ns per frame of drawing the whole wipe, repeated
+// for at least target_ns.
+static double time_wipe(GContext *ctx, WipeRectFunc *func, const BenchWipe *wipe, bool damage_only) {
+  long wipes = 0;
+  double start = now_ns();
+  double elapsed;
+  do {
+    for (int ti = 0; ti <= NUM_TRANSITION_FRAMES_HOUR; ++ti) {
+      draw_frame(ctx, func, wipe, ti, damage_only);
+    }
+    ++wipes;
+    elapsed = now_ns() - start;
+  } while (elapsed < target_ns);
+  return elapsed / (wipes * (NUM_TRANSITION_FRAMES_HOUR + 1));
+}
+
+// Plays the wipe through both paths side by side, comparing the
+// framebuffers after every frame.  Returns the number of frames that
+// differ.
+static int check_wipe(const BenchWipe *wipe, bool damage_only) {
+  GContext *multi = host_gcontext_create(SCREEN_WIDTH, SCREEN_HEIGHT);
+  GContext *single = host_gcontext_create(SCREEN_WIDTH, SCREEN_HEIGHT);
+  size_t fb_size = multi->framebuffer->row_size_bytes * SCREEN_HEIGHT;
+  // Start from garbage, to be sure the first frame covers everything.
+  for (size_t i = 0; i < fb_size; ++i) {
+    ((uint8_t *)multi->framebuffer->addr)[i] = ((uint8_t *)single->framebuffer->addr)[i] = rand();
+  }
+
+  int mismatches = 0;
+  for (int ti = 0; ti <= NUM_TRANSITION_FRAMES_HOUR; ++ti) {
+    draw_frame(multi, &draw_wipe_rect, wipe, ti, damage_only);
+    draw_frame(single, &compose_wipe_rect, wipe, ti, damage_only);
+    if (memcmp(multi->framebuffer->addr, single->framebuffer->addr, fb_size) != 0) {
+      ++mismatches;
+    }
+  }
+
+  host_gcontext_destroy(multi);
+  host_gcontext_destroy(single);
+  return mismatches;
+}
+
+int main(int argc, char *argv[]) {
+  int opt;
+  while ((opt = getopt(argc, argv, "t:")) != -1) {
+    switch (opt) {
+    case 't':
+      target_ns = atof(optarg) * 1e6;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-t ms]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  printf("Hour wipe, twelve over eleven: ns per frame, for the whole screen\n");
+  printf("and for just the damage since the previous frame.\n\n");
+  printf("%-10s %12s %12s %8s %12s %12s %8s  %s\n", "sprite",
+         "multi/full", "single/full", "speedup", "multi/dmg", "single/dmg", "speedup", "check");
+
+  int failures = 0;
+  GContext *ctx = host_gcontext_create(SCREEN_WIDTH, SCREEN_HEIGHT);
+  for (size_t i = 0; i < NUM_BENCH_SPRITES; ++i) {
+    BenchWipe wipe;
+    bench_wipe_init(&wipe, &bench_sprites[i]);
+
+    int mismatches = check_wipe(&wipe, false) + check_wipe(&wipe, true);
+    failures += mismatches;
+
+    double multi_full = time_wipe(ctx, &draw_wipe_rect, &wipe, false);
+    double single_full = time_wipe(ctx, &compose_wipe_rect, &wipe, false);
+    double multi_damage = time_wipe(ctx, &draw_wipe_rect, &wipe, true);
+    double single_damage = time_wipe(ctx, &compose_wipe_rect, &wipe, true);
+    printf("%-10s %12.0f %12.0f %7.1fx %12.0f %12.0f %7.1fx  %s\n", bench_sprites[i].name,
+           multi_full, single_full, multi_full / single_full,
+           multi_damage, single_damage, multi_damage / single_damage,
+           mismatches ? "MISMATCH" : "ok");
+
+    bench_wipe_deinit(&wipe);
+  }
+  host_gcontext_destroy(ctx);
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,277 @@
+// Checks the word-at-a-time bitmap kernels against naive versions
+// that work a pixel at a time.  See the Makefile for how to build and
+// run this.
+//
+// check_bwd [bands.rle ...]
+//
+// bitmap_flip_x(), bitmap_shift_x() and bwd_crop() are checked on
+// random bitmaps of every width from 1 to MAX_CHECK_WIDTH, each with
+// the narrowest stride and with wider ones (as a bitmap whose rows
+// have room to spare would have), at every shift and every crop
+// origin.  Besides the pixels themselves, the padding at the end of
+// each row must come out black, as the decoder leaves it.
+//
+// Each of the row-indexed (format 1) .rle files named on the command
+// line, which the Makefile encodes from a face, has its bands decoded
+// one at a time with rle_decode_band(), in a random order, and the
+// result checked against decoding the whole file at once.
+
+#include <pebble.h>
+#include "bwd.h"
+#include "bitmap_transform.h"
+
+// A little wider than the screen, so that every case of a row's last
+// word (and of more than one word) comes up.
+#define MAX_CHECK_WIDTH 170
+#define CHECK_HEIGHT 3
+
+// The extra words, beyond the narrowest stride, to try each bitmap with.
+#define MAX_EXTRA_WORDS 2
+
+static int failures = 0;
+
+// A fixed xorshift generator, so that every run checks the same bitmaps.
+static uint32_t check_rand_state = 2463534242u;
+
+static uint32_t check_rand() {
+  check_rand_state ^= check_rand_state << 13;
+  check_rand_state ^= check_rand_state >> 17;
+  check_rand_state ^= check_rand_state << 5;
+  return check_rand_state;
+}
+
+static int get_pixel(const GBitmap *bitmap, int x, int y) {
+  const uint8_t *row = (const uint8_t *)bitmap->addr + y * bitmap->row_size_bytes;
+  return (row[x / 8] >> (x % 8)) & 1;
+}
+
+static void set_pixel(GBitmap *bitmap, int x, int y, int value) {
+  uint8_t *row = (uint8_t *)bitmap->addr + y * bitmap->row_size_bytes;
+  if (value) {
+    row[x / 8] |= 1 << (x % 8);
+  } else {
+    row[x / 8] &= ~(1 << (x % 8));
+  }
+}
+
+// Makes a cleared bitmap with extra_words more words per row than it
+// needs.  Release it with free_bitmap().
+static GBitmap *make_bitmap(int width, int height, int extra_words) {
+  GBitmap *bitmap = malloc(sizeof(GBitmap));
+  memset(bitmap, 0, sizeof(GBitmap));
+  bitmap->row_size_bytes = ((width + 31) / 32 + extra_words) * 4;
+  bitmap->bounds = GRect(0, 0, width, height);
+  bitmap->addr = malloc(bitmap->row_size_bytes * height);
+  memset(bitmap->addr, 0, bitmap->row_size_bytes * height);
+  return bitmap;
+}
+
+static void free_bitmap(GBitmap *bitmap) {
+  free(bitmap->addr);
+  free(bitmap);
+}
+
+// Makes a bitmap of random pixels, with black padding.
+static GBitmap *make_random_bitmap(int width, int height, int extra_words) {
+  GBitmap *bitmap = make_bitmap(width, height, extra_words);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      set_pixel(bitmap, x, y, check_rand() & 1);
+    }
+  }
+  return bitmap;
+}
+
+static GBitmap *copy_bitmap(const GBitmap *source) {
+  int width = source->bounds.size.w;
+  int extra_words = source->row_size_bytes / 4 - (width + 31) / 32;
+  GBitmap *bitmap = make_bitmap(width, source->bounds.size.h, extra_words);
+  memcpy(bitmap->addr, source->addr, source->row_size_bytes * source->bounds.size.h);
+  return bitmap;
+}
+
+// Returns true if the two bitmaps have the same pixels, and got has
+// nothing but black in its padding.  Otherwise reports the first
+// difference, under the indicated name.
+static bool check_same(const char *name, const GBitmap *got, const GBitmap *want) {
+  int width = want->bounds.size.w;
+  int height = want->bounds.size.h;
+  if (got->bounds.size.w != width || got->bounds.size.h != height) {
+    fprintf(stderr, "%s: got %dx%d, want %dx%d\n", name,
+            got->bounds.size.w, got->bounds.size.h, width, height);
+    ++failures;
+    return false;
+  }
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < got->row_size_bytes * 8; ++x) {
+      int want_pixel = (x < width) ? get_pixel(want, x, y) : 0;
+      if (get_pixel(got, x, y) != want_pixel) {
+        fprintf(stderr, "%s: pixel (%d, %d) is %d, want %d%s\n", name, x, y,
+                get_pixel(got, x, y), want_pixel, (x < width) ? "" : " (padding)");
+        ++failures;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static void naive_flip_x(GBitmap *dest, const GBitmap *source) {
+  int width = source->bounds.size.w;
+  for (int y = 0; y < source->bounds.size.h; ++y) {
+    for (int x = 0; x < width; ++x) {
+      set_pixel(dest, x, y, get_pixel(source, width - 1 - x, y));
+    }
+  }
+}
+
+static void naive_shift_x(GBitmap *dest, const GBitmap *source, int dx) {
+  int width = source->bounds.size.w;
+  for (int y = 0; y < source->bounds.size.h; ++y) {
+    for (int x = 0; x < width; ++x) {
+      int sx = x - dx;
+      set_pixel(dest, x, y, (sx >= 0 && sx < width) ? get_pixel(source, sx, y) : 0);
+    }
+  }
+}
+
+static void naive_crop(GBitmap *dest, const GBitmap *source, GRect rect) {
+  for (int y = 0; y < rect.size.h; ++y) {
+    for (int x = 0; x < rect.size.w; ++x) {
+      set_pixel(dest, x, y, get_pixel(source, rect.origin.x + x, rect.origin.y + y));
+    }
+  }
+}
+
+static void check_flip_x(const GBitmap *source) {
+  char name[96];
+  snprintf(name, sizeof(name), "bitmap_flip_x width %d stride %d",
+           source->bounds.size.w, source->row_size_bytes);
+
+  GBitmap *want = make_bitmap(source->bounds.size.w, source->bounds.size.h, 0);
+  naive_flip_x(want, source);
+  GBitmap *got = copy_bitmap(source);
+  bitmap_flip_x(got);
+  if (check_same(name, got, want)) {
+    // Flipping back must restore the original.
+    bitmap_flip_x(got);
+    check_same(name, got, source);
+  }
+  free_bitmap(got);
+  free_bitmap(want);
+}
+
+static void check_shift_x(const GBitmap *source) {
+  int width = source->bounds.size.w;
+  GBitmap *want = make_bitmap(width, source->bounds.size.h, 0);
+  for (int dx = -width - 2; dx <= width + 2; ++dx) {
+    char name[96];
+    snprintf(name, sizeof(name), "bitmap_shift_x width %d stride %d dx %d",
+             width, source->row_size_bytes, dx);
+    naive_shift_x(want, source, dx);
+    GBitmap *got = copy_bitmap(source);
+    bitmap_shift_x(got, dx);
+    check_same(name, got, want);
+    free_bitmap(got);
+  }
+  free_bitmap(want);
+}
+
+static void check_crop_rect(const GBitmap *source, GRect rect) {
+  char name[96];
+  snprintf(name, sizeof(name), "bwd_crop width %d stride %d rect (%d, %d, %d, %d)",
+           source->bounds.size.w, source->row_size_bytes,
+           rect.origin.x, rect.origin.y, rect.size.w, rect.size.h);
+
+  GBitmap *want = make_bitmap(rect.size.w, rect.size.h, 0);
+  naive_crop(want, source, rect);
+  BitmapWithData got = bwd_crop((GBitmap *)source, rect);
+  check_same(name, got.bitmap, want);
+  bwd_destroy(&got);
+  free_bitmap(want);
+}
+
+// Crops at every origin, to the narrowest, the widest and a middling
+// width that fit there.
+static void check_crop(const GBitmap *source) {
+  int width = source->bounds.size.w;
+  int height = source->bounds.size.h;
+  for (int x = 0; x < width; ++x) {
+    int widest = width - x;
+    check_crop_rect(source, GRect(x, 0, widest, height));
+    check_crop_rect(source, GRect(x, 1, 1, height - 1));
+    if (widest > 2) {
+      check_crop_rect(source, GRect(x, 0, widest / 2 + 1, 1));
+    }
+  }
+}
+
+// Decodes each band of the row-indexed .rle file on its own, in a
+// random order, into a bitmap that starts out full of garbage, and
+// checks that it comes out the same as the whole file decoded at once.
+static void check_bands(const char *filename) {
+  uint32_t resource_id = host_resource_add_file(filename);
+  RleHeader header;
+  rle_header_init(resource_id, &header);
+  if (header.format != RLE_FORMAT_BANDS || header.num_bands < 2) {
+    fprintf(stderr, "%s: format %d with %d bands, not a row-indexed file\n",
+            filename, header.format, header.num_bands);
+    ++failures;
+    return;
+  }
+
+  BitmapWithData want = rle_bwd_create(resource_id);
+  GBitmap *got = make_bitmap(header.width, header.height, header.stride / 4 - (header.width + 31) / 32);
+  for (int i = 0; i < header.height * header.stride; ++i) {
+    ((uint8_t *)got->addr)[i] = check_rand();
+  }
+
+  int order[256];
+  for (int band = 0; band < header.num_bands; ++band) {
+    order[band] = band;
+  }
+  for (int i = header.num_bands - 1; i > 0; --i) {
+    int j = check_rand() % (i + 1);
+    int t = order[i];
+    order[i] = order[j];
+    order[j] = t;
+  }
+  for (int i = 0; i < header.num_bands; ++i) {
+    int band = order[i];
+    rle_decode_band(&header, band, (uint8_t *)got->addr + band * header.band_rows * header.stride);
+  }
+
+  char name[96];
+  snprintf(name, sizeof(name), "rle_decode_band %s", filename);
+  check_same(name, got, want.bitmap);
+  free_bitmap(got);
+  bwd_destroy(&want);
+}
+
+int main(int argc, char *argv[]) {
+  int checked = 0;
+  for (int width = 1; width <= MAX_CHECK_WIDTH; ++width) {
+    for (int extra_words = 0; extra_words <= MAX_EXTRA_WORDS; ++extra_words) {
+      GBitmap *source = make_random_bitmap(width, CHECK_HEIGHT, extra_words);
+      check_flip_x(source);
+      check_shift_x(source);
+      check_crop(source);
+      free_bitmap(source);
+      ++checked;
+    }
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    check_bands(argv[i]);
+  }
+
+  if (failures != 0) {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+  printf("bitmap_flip_x, bitmap_shift_x and bwd_crop match on all %d bitmaps\n", checked);
+  if (argc > 1) {
+    printf("rle_decode_band matches the whole decode of all %d row-indexed files\n", argc - 1);
+  }
+  return 0;
+}
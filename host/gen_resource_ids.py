@@ -0,0 +1,86 @@
+#! /usr/bin/env python3
+
+""" gen_resource_ids.py
+
+Reads the resource list from appinfo.json and writes the two headers
+the host build needs: resource_ids.auto.h, which assigns the same
+RESOURCE_ID_* numbers the Pebble SDK would, and resource_table.auto.h,
+which maps each id back to its file in resources/.
+
+The png resources are converted, as the SDK does, to 1-bpp pbi
+images in output_dir, which the table refers to instead.
+
+gen_resource_ids.py appinfo.json output_dir
+"""
+
+import json
+import os
+import struct
+import sys
+
+def write_pbi(png_filename, pbi_filename):
+    """ Converts a png to the SDK's pbi format: the header described
+    in bwd.h, followed by 1-bpp rows padded to a whole number of
+    words, with the first pixel of each byte in its low bit. """
+
+    from PIL import Image
+    image = Image.open(png_filename).convert('L')
+    w, h = image.size
+    stride = ((w + 31) // 32) * 4
+    data = bytearray(stride * h)
+    pixels = image.load()
+    for y in range(h):
+        for x in range(w):
+            if pixels[x, y] >= 128:
+                data[y * stride + x // 8] |= 1 << (x % 8)
+
+    write_file(pbi_filename, struct.pack('<HHhhhh', stride, 0, 0, 0, w, h) + data)
+
+def write_file(filename, data):
+    """ Writes data to filename by way of a temporary file, so that a
+    run which fails part way leaves behind either the old file or
+    none at all, never a truncated one that make would think was up
+    to date. """
+
+    if isinstance(data, str):
+        data = data.encode('utf-8')
+    temp_filename = filename + '.tmp'
+    f = open(temp_filename, 'wb')
+    f.write(data)
+    f.close()
+    os.replace(temp_filename, filename)
+
+def main(appinfo_filename, output_dir):
+    appinfo = json.load(open(appinfo_filename))
+    media = appinfo['resources']['media']
+
+    # The SDK numbers resources from 1, in the order they appear.
+    ids = '// Generated by gen_resource_ids.py; do not edit.\n'
+    ids += '#ifndef RESOURCE_IDS_AUTO_H\n#define RESOURCE_IDS_AUTO_H\n\n'
+    ids += 'typedef enum {\n  INVALID_RESOURCE = 0,\n'
+    for entry in media:
+        ids += '  RESOURCE_ID_%s,\n' % (entry['name'])
+    ids += '  NUM_HOST_RESOURCES,\n} ResourceId;\n\n#endif\n'
+
+    table = '// Generated by gen_resource_ids.py; do not edit.\n'
+    table += 'static const char *host_resource_files[NUM_HOST_RESOURCES] = {\n  NULL,\n'
+    project_dir = os.path.dirname(os.path.abspath(appinfo_filename))
+    for entry in media:
+        filename = entry['file']
+        if entry['type'] == 'png':
+            pbi_filename = os.path.join(os.path.abspath(output_dir), entry['name'].lower() + '.pbi')
+            write_pbi(os.path.join(project_dir, 'resources', filename), pbi_filename)
+            filename = pbi_filename
+        table += '  "%s",\n' % (filename)
+    table += '};\n'
+
+    # The headers are written only once every pbi has been, so that
+    # they're never newer than a failed conversion.
+    write_file(os.path.join(output_dir, 'resource_ids.auto.h'), ids)
+    write_file(os.path.join(output_dir, 'resource_table.auto.h'), table)
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        print(__doc__, file = sys.stderr)
+        sys.exit(1)
+    main(sys.argv[1], sys.argv[2])
@@ -0,0 +1,403 @@
+// Checks every hour transition against golden images, and measures
+// what each of its frames costs to render.  See the Makefile for how
+// to build and run this.
+//
+// golden [-u] [-f file] [-o dir] [-r file] [-n rounds]
+//
+//   -u         Update the golden file from this run, rather than
+//              checking against it.
+//   -f file    The golden file (default golden/transitions.txt).
+//   -o dir     Write every frame to dir, as <transition>_NN.pbm, to
+//              see the images behind the hashes.
+//   -r file    Write the render cost of every frame to file, as
+//              tab-separated values.
+//   -n rounds  Run each transition this many times, and report the
+//              fastest render of each frame (default 1).
+//
+// A transition is a face (the twelve hours, and Hurt at 8:30), a
+// sprite, a wipe direction and an animation direction: 156 in all.
+// Each one is run in a fresh simulator, from the previous face, with
+// the seed of rand() that makes prepare_sprite() choose it.  Every
+// frame the face layer draws, from start_transition() up to and
+// including the one that stops the transition, is a golden image.
+// The golden file holds the FNV-1a hash of each of those images,
+// rather than the images themselves, to keep it small; -o recovers
+// the images.
+
+#include <pebble.h>
+#include <getopt.h>
+#include "sim.h"
+
+// From doctors.c.
+extern bool face_transition;
+extern bool wipe_direction;
+extern bool anim_direction;
+extern int sprite_sel;
+void handle_init();
+void handle_deinit();
+void start_transition(int face_new, bool for_startup);
+
+#define NUM_FACES 13
+#define HURT_FACE 12
+#define NUM_SPRITES 3
+
+// Generously more frames than any transition takes.
+#define MAX_FRAMES 64
+
+// How long to let any one transition run, in virtual ms.
+#define MAX_TRANSITION_MS 10000
+
+static const char *face_names[NUM_FACES] = {
+  "twelve", "one", "two", "three", "four", "five", "six",
+  "seven", "eight", "nine", "ten", "eleven", "hurt",
+};
+
+// Indexed by the SPRITE_* values in doctors.c.
+static const char *sprite_names[NUM_SPRITES] = {
+  "tardis", "k9", "dalek",
+};
+
+typedef struct {
+  int face;
+  int sprite;
+  bool wipe_direction;
+  bool anim_direction;
+  int num_frames;
+  uint32_t hashes[MAX_FRAMES];
+  uint32_t render_ns[MAX_FRAMES];  // The fastest of all the rounds.
+} Transition;
+
+#define NUM_TRANSITIONS (NUM_FACES * NUM_SPRITES * 2 * 2)
+static Transition transitions[NUM_TRANSITIONS];
+
+// The transition whose frames the frame hook is capturing, or NULL.
+static Transition *capturing = NULL;
+static int capture_frame;
+static int capture_round;
+
+static const char *frame_dir = NULL;
+
+// The start of each run: well clear of the hour, and of the minute.
+#define START_TIME 1388571600  // 2014-01-01 10:20:00 UTC
+
+static void transition_name(const Transition *t, char *buffer, size_t size) {
+  snprintf(buffer, size, "%s_%s_%s_%s", face_names[t->face], sprite_names[t->sprite],
+           t->wipe_direction ? "lr" : "rl", t->anim_direction ? "rev" : "fwd");
+}
+
+// FNV-1a over the framebuffer.
+static uint32_t frame_hash(GBitmap *fb) {
+  uint32_t hash = 2166136261u;
+  int width_bytes = (fb->bounds.size.w + 7) / 8;
+  for (int y = 0; y < fb->bounds.size.h; ++y) {
+    uint8_t *row = (uint8_t *)fb->addr + y * fb->row_size_bytes;
+    for (int x = 0; x < width_bytes; ++x) {
+      hash = (hash ^ row[x]) * 16777619u;
+    }
+  }
+  return hash;
+}
+
+static void capture_hook(GContext *ctx, uint32_t render_ns) {
+  Transition *t = capturing;
+  if (t == NULL) {
+    return;
+  }
+  int frame = capture_frame++;
+  if (frame >= MAX_FRAMES) {
+    fprintf(stderr, "too many frames\n");
+    exit(1);
+  }
+
+  uint32_t hash = frame_hash(ctx->framebuffer);
+  if (capture_round == 0) {
+    t->hashes[frame] = hash;
+    t->render_ns[frame] = render_ns;
+    t->num_frames = frame + 1;
+  } else {
+    if (hash != t->hashes[frame]) {
+      fprintf(stderr, "frame %d differs from one round to the next\n", frame);
+      exit(1);
+    }
+    if (render_ns < t->render_ns[frame]) {
+      t->render_ns[frame] = render_ns;
+    }
+  }
+
+  if (frame_dir != NULL && capture_round == 0) {
+    char name[64];
+    char filename[512];
+    transition_name(t, name, sizeof(name));
+    snprintf(filename, sizeof(filename), "%s/%s_%02d.pbm", frame_dir, name, frame);
+    if (!sim_write_pbm(filename)) {
+      perror(filename);
+      exit(1);
+    }
+  }
+}
+
+static bool transition_done() {
+  return !face_transition;
+}
+
+// Returns the seed that makes prepare_sprite() choose t's sprite and
+// directions, drawing from rand() in the order it does.
+static unsigned int find_seed(const Transition *t) {
+  for (unsigned int seed = 1; ; ++seed) {
+    srand(seed);
+    bool w = (rand() % 2) != 0;
+    int s = rand() % NUM_SPRITES;
+    bool a = (rand() % 2) != 0;
+    if (w == t->wipe_direction && s == t->sprite && a == t->anim_direction) {
+      return seed;
+    }
+  }
+}
+
+static void run_transition(Transition *t) {
+  int prev_face = (t->face == HURT_FACE) ? 8 : (t->face + 11) % 12;
+
+  sim_config.start_time = START_TIME;
+  sim_init();
+  handle_init();
+  sim_run(MAX_TRANSITION_MS, &transition_done);
+  start_transition(prev_face, true);
+  sim_run(MAX_TRANSITION_MS, &transition_done);
+
+  srand(find_seed(t));
+  capturing = t;
+  capture_frame = 0;
+  start_transition(t->face, false);
+  if (sprite_sel != t->sprite || wipe_direction != t->wipe_direction ||
+      anim_direction != t->anim_direction) {
+    fprintf(stderr, "prepare_sprite() didn't choose the transition we seeded it for;\n"
+            "has the order in which it calls rand() changed?\n");
+    exit(1);
+  }
+  if (!sim_run(MAX_TRANSITION_MS, &transition_done)) {
+    fprintf(stderr, "transition didn't finish\n");
+    exit(1);
+  }
+  capturing = NULL;
+
+  handle_deinit();
+  sim_deinit();
+}
+
+// Reads the golden file and compares it with this run.  Returns the
+// number of transitions that don't match.
+static int check_golden(const char *filename) {
+  FILE *f = fopen(filename, "r");
+  if (f == NULL) {
+    perror(filename);
+    return NUM_TRANSITIONS;
+  }
+
+  int num_mismatched = 0;
+  bool seen[NUM_TRANSITIONS];
+  memset(seen, 0, sizeof(seen));
+  char line[1024];
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+    char name[64];
+    int num_frames;
+    int pos;
+    if (sscanf(line, "%63s %d%n", name, &num_frames, &pos) != 2) {
+      fprintf(stderr, "%s: bad line: %s", filename, line);
+      continue;
+    }
+
+    Transition *t = NULL;
+    for (int i = 0; i < NUM_TRANSITIONS && t == NULL; ++i) {
+      char this_name[64];
+      transition_name(&transitions[i], this_name, sizeof(this_name));
+      if (strcmp(name, this_name) == 0) {
+        t = &transitions[i];
+        seen[i] = true;
+      }
+    }
+    if (t == NULL) {
+      fprintf(stderr, "%s: unknown transition %s\n", filename, name);
+      continue;
+    }
+
+    bool match = (num_frames == t->num_frames);
+    for (int frame = 0; frame < num_frames && match; ++frame) {
+      unsigned int hash;
+      int n;
+      if (sscanf(line + pos, "%x%n", &hash, &n) != 1) {
+        match = false;
+        break;
+      }
+      pos += n;
+      if (hash != t->hashes[frame]) {
+        printf("%s: frame %d differs\n", name, frame);
+        match = false;
+      }
+    }
+    if (num_frames != t->num_frames) {
+      printf("%s: %d frames, not %d\n", name, t->num_frames, num_frames);
+    }
+    if (!match) {
+      num_mismatched++;
+    }
+  }
+  fclose(f);
+
+  for (int i = 0; i < NUM_TRANSITIONS; ++i) {
+    if (!seen[i]) {
+      char name[64];
+      transition_name(&transitions[i], name, sizeof(name));
+      printf("%s: not in %s\n", name, filename);
+      num_mismatched++;
+    }
+  }
+  return num_mismatched;
+}
+
+static bool write_golden(const char *filename) {
+  FILE *f = fopen(filename, "w");
+  if (f == NULL) {
+    perror(filename);
+    return false;
+  }
+  fprintf(f, "# Written by golden -u; see golden.c.\n");
+  fprintf(f, "# transition, number of frames, and the hash of each frame.\n");
+  for (int i = 0; i < NUM_TRANSITIONS; ++i) {
+    Transition *t = &transitions[i];
+    char name[64];
+    transition_name(t, name, sizeof(name));
+    fprintf(f, "%s %d", name, t->num_frames);
+    for (int frame = 0; frame < t->num_frames; ++frame) {
+      fprintf(f, " %08x", t->hashes[frame]);
+    }
+    fprintf(f, "\n");
+  }
+  return fclose(f) == 0;
+}
+
+static bool write_report(const char *filename) {
+  FILE *f = fopen(filename, "w");
+  if (f == NULL) {
+    perror(filename);
+    return false;
+  }
+  fprintf(f, "transition\tframe\trender_ns\n");
+  for (int i = 0; i < NUM_TRANSITIONS; ++i) {
+    Transition *t = &transitions[i];
+    char name[64];
+    transition_name(t, name, sizeof(name));
+    for (int frame = 0; frame < t->num_frames; ++frame) {
+      fprintf(f, "%s\t%d\t%u\n", name, frame, t->render_ns[frame]);
+    }
+  }
+  return fclose(f) == 0;
+}
+
+// Prints the mean and worst render cost of the frames with each
+// sprite, which is what mostly decides it.
+static void print_summary() {
+  printf("%-8s %12s %10s %10s\n", "sprite", "transitions", "mean us", "max us");
+  for (int sprite = 0; sprite < NUM_SPRITES; ++sprite) {
+    double total_ns = 0;
+    uint32_t max_ns = 0;
+    int num_frames = 0;
+    int num_transitions = 0;
+    for (int i = 0; i < NUM_TRANSITIONS; ++i) {
+      Transition *t = &transitions[i];
+      if (t->sprite != sprite) {
+        continue;
+      }
+      num_transitions++;
+      for (int frame = 0; frame < t->num_frames; ++frame) {
+        total_ns += t->render_ns[frame];
+        max_ns = (t->render_ns[frame] > max_ns) ? t->render_ns[frame] : max_ns;
+        num_frames++;
+      }
+    }
+    printf("%-8s %12d %10.1f %10.1f\n", sprite_names[sprite], num_transitions,
+           num_frames ? total_ns / num_frames / 1000 : 0.0, max_ns / 1000.0);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  setenv("TZ", "UTC0", 1);
+  tzset();
+
+  const char *golden_filename = "golden/transitions.txt";
+  const char *report_filename = NULL;
+  int num_rounds = 1;
+  bool update = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "uf:o:r:n:")) != -1) {
+    switch (opt) {
+    case 'u':
+      update = true;
+      break;
+    case 'f':
+      golden_filename = optarg;
+      break;
+    case 'o':
+      frame_dir = optarg;
+      break;
+    case 'r':
+      report_filename = optarg;
+      break;
+    case 'n':
+      num_rounds = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-u] [-f file] [-o dir] [-r file] [-n rounds]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  // Quiet the app's routine logging.
+  host_log_level = APP_LOG_LEVEL_WARNING;
+
+  int i = 0;
+  for (int face = 0; face < NUM_FACES; ++face) {
+    for (int sprite = 0; sprite < NUM_SPRITES; ++sprite) {
+      for (int w = 0; w < 2; ++w) {
+        for (int a = 0; a < 2; ++a) {
+          Transition *t = &transitions[i++];
+          t->face = face;
+          t->sprite = sprite;
+          t->wipe_direction = w;
+          t->anim_direction = a;
+        }
+      }
+    }
+  }
+
+  sim_config.frame_hook = &capture_hook;
+  for (capture_round = 0; capture_round < num_rounds; ++capture_round) {
+    for (i = 0; i < NUM_TRANSITIONS; ++i) {
+      run_transition(&transitions[i]);
+    }
+  }
+
+  if (report_filename != NULL && !write_report(report_filename)) {
+    return 1;
+  }
+  print_summary();
+
+  if (update) {
+    if (!write_golden(golden_filename)) {
+      return 1;
+    }
+    printf("wrote %d transitions to %s\n", NUM_TRANSITIONS, golden_filename);
+    return 0;
+  }
+
+  int num_mismatched = check_golden(golden_filename);
+  if (num_mismatched != 0) {
+    printf("%d of %d transitions don't match %s\n", num_mismatched, NUM_TRANSITIONS, golden_filename);
+    return 1;
+  }
+  printf("all %d transitions match %s\n", NUM_TRANSITIONS, golden_filename);
+  return 0;
+}
@@ -0,0 +1,340 @@
+#ifndef HOST_PEBBLE_H
+#define HOST_PEBBLE_H
+
+// A minimal stand-in for the Pebble SDK's pebble.h, just enough to
+// build the watchface on a desktop machine, for benchmarking its
+// bitmap code and for running the whole app in the simulator.  Only
+// the parts of the API that the src/ modules actually use are
+// provided here; see pebble_host.c for the resources and graphics,
+// and pebble_sim.c for the app framework.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "resource_ids.auto.h"
+
+typedef struct {
+  int16_t x;
+  int16_t y;
+} GPoint;
+
+typedef struct {
+  int16_t w;
+  int16_t h;
+} GSize;
+
+typedef struct {
+  GPoint origin;
+  GSize size;
+} GRect;
+
+#define GPoint(x, y) ((GPoint){(x), (y)})
+#define GSize(w, h) ((GSize){(w), (h)})
+#define GRect(x, y, w, h) ((GRect){{(x), (y)}, {(w), (h)}})
+
+bool grect_is_empty(const GRect *const rect);
+void grect_clip(GRect *const rect_to_clip, const GRect *const rect_clipper);
+
+// Same layout as the SDK 2 GBitmap, whose fields the watchface reads
+// directly.
+typedef struct GBitmap {
+  void *addr;
+  uint16_t row_size_bytes;
+  uint16_t info_flags;
+  GRect bounds;
+} GBitmap;
+
+typedef void *ResHandle;
+
+typedef enum {
+  APP_LOG_LEVEL_ERROR = 1,
+  APP_LOG_LEVEL_WARNING = 50,
+  APP_LOG_LEVEL_INFO = 100,
+  APP_LOG_LEVEL_DEBUG = 200,
+  APP_LOG_LEVEL_DEBUG_VERBOSE = 255,
+} AppLogLevel;
+
+// Messages above this level aren't logged.
+extern uint8_t host_log_level;
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...);
+
+// The simulator's virtual clock, in ms since the epoch, or -1 to use
+// the real clock.  The app's calls to time() are routed through
+// host_time(), which reads this.
+extern int64_t host_clock_ms;
+
+time_t host_time(time_t *tloc);
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms);
+
+#ifndef HOST_NO_CLOCK_HOOKS
+#define time(tloc) host_time(tloc)
+#endif  // HOST_NO_CLOCK_HOOKS
+
+// The app's rand() is a fixed generator, rather than the C library's,
+// so a seed picks the same transitions on every host.
+int host_rand(void);
+void host_srand(unsigned int seed);
+
+#ifndef HOST_NO_RAND_HOOKS
+#define rand() host_rand()
+#define srand(seed) host_srand(seed)
+#endif  // HOST_NO_RAND_HOOKS
+
+ResHandle resource_get_handle(uint32_t resource_id);
+size_t resource_size(ResHandle h);
+size_t resource_load_byte_range(ResHandle h, uint32_t start_offset, uint8_t *buffer, size_t num_bytes);
+
+// Makes the indicated file available as a resource, beyond those in
+// appinfo.json, for a check of an encoding no resource of the app's
+// uses; a relative filename is taken from the current directory.
+// Returns its resource id.
+uint32_t host_resource_add_file(const char *filename);
+
+GBitmap *gbitmap_create_with_data(const uint8_t *data);
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id);
+void gbitmap_destroy(GBitmap *bitmap);
+
+typedef enum {
+  GColorClear = ~0,
+  GColorBlack = 0,
+  GColorWhite = 1,
+} GColor;
+
+typedef enum {
+  GCompOpAssign,
+  GCompOpAssignInverted,
+  GCompOpOr,
+  GCompOpAnd,
+  GCompOpClear,
+  GCompOpSet,
+} GCompOp;
+
+typedef enum {
+  GCornerNone = 0,
+} GCornerMask;
+
+// The host's drawing context is just a 1-bpp framebuffer and the
+// drawing state the watchface sets; see host_gcontext_create().
+// Drawing is relative to the origin of draw_box, the frame of the
+// layer being drawn, and clipped to clip_box.
+typedef struct GContext {
+  GBitmap *framebuffer;
+  GRect draw_box;
+  GRect clip_box;
+  GCompOp compositing_mode;
+  GColor fill_color;
+  GColor text_color;
+  bool framebuffer_captured;
+} GContext;
+
+GContext *host_gcontext_create(int width, int height);
+void host_gcontext_destroy(GContext *ctx);
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode);
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask);
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect);
+GBitmap *graphics_capture_frame_buffer(GContext *ctx);
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer);
+
+// Text.  The host has none of the firmware's fonts; see pebble_sim.c
+// for its stand-in for the one the watchface uses.
+typedef enum {
+  GTextOverflowModeWordWrap,
+  GTextOverflowModeTrailingEllipsis,
+  GTextOverflowModeFill,
+} GTextOverflowMode;
+
+typedef enum {
+  GTextAlignmentLeft,
+  GTextAlignmentCenter,
+  GTextAlignmentRight,
+} GTextAlignment;
+
+typedef struct HostFont *GFont;
+typedef void *GTextLayoutCacheRef;
+
+#define FONT_KEY_BITHAM_30_BLACK "RESOURCE_ID_BITHAM_30_BLACK"
+
+GFont fonts_get_system_font(const char *font_key);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_draw_text(GContext *ctx, const char *text, const GFont font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        const GTextLayoutCacheRef layout);
+
+// Allocation accounting, so the benchmarks can report allocations
+// per call.  Code built against this header has its malloc() and
+// free() calls routed through these counters.  If host_heap_limit is
+// nonzero, allocations beyond that many bytes in use fail, as they
+// would on the watch.
+typedef struct {
+  unsigned long allocs;
+  unsigned long frees;
+  unsigned long bytes_allocated;
+  size_t bytes_in_use;
+  size_t peak_bytes_in_use;
+} HostHeapStats;
+
+extern HostHeapStats host_heap_stats;
+extern size_t host_heap_limit;
+
+void *host_malloc(size_t size);
+void host_free(void *ptr);
+size_t heap_bytes_free(void);
+size_t heap_bytes_used(void);
+
+#ifndef HOST_NO_ALLOC_HOOKS
+#define malloc(size) host_malloc(size)
+#define free(ptr) host_free(ptr)
+#endif  // HOST_NO_ALLOC_HOOKS
+
+// The app framework, as simulated by pebble_sim.c.
+
+typedef struct Layer Layer;
+typedef void (*LayerUpdateProc)(Layer *layer, GContext *ctx);
+
+Layer *layer_create(GRect frame);
+void layer_destroy(Layer *layer);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+void layer_add_child(Layer *parent, Layer *child);
+void layer_mark_dirty(Layer *layer);
+GRect layer_get_frame(const Layer *layer);
+GRect layer_get_bounds(const Layer *layer);
+
+typedef struct Window Window;
+typedef void (*WindowHandler)(Window *window);
+
+typedef struct {
+  WindowHandler load;
+  WindowHandler appear;
+  WindowHandler disappear;
+  WindowHandler unload;
+} WindowHandlers;
+
+Window *window_create(void);
+void window_destroy(Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+void window_set_background_color(Window *window, GColor background_color);
+Layer *window_get_root_layer(const Window *window);
+void window_stack_push(Window *window, bool animated);
+void window_stack_pop_all(bool animated);
+
+void app_event_loop(void);
+
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data);
+bool app_timer_reschedule(AppTimer *timer, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer);
+
+typedef enum {
+  SECOND_UNIT = 1 << 0,
+  MINUTE_UNIT = 1 << 1,
+  HOUR_UNIT = 1 << 2,
+  DAY_UNIT = 1 << 3,
+  MONTH_UNIT = 1 << 4,
+  YEAR_UNIT = 1 << 5,
+} TimeUnits;
+
+typedef void (*TickHandler)(struct tm *tick_time, TimeUnits units_changed);
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler);
+void tick_timer_service_unsubscribe(void);
+
+typedef struct {
+  uint8_t charge_percent;
+  bool is_charging;
+  bool is_plugged;
+} BatteryChargeState;
+
+typedef void (*BatteryStateHandler)(BatteryChargeState charge);
+
+BatteryChargeState battery_state_service_peek(void);
+void battery_state_service_subscribe(BatteryStateHandler handler);
+void battery_state_service_unsubscribe(void);
+
+typedef void (*BluetoothConnectionHandler)(bool connected);
+
+bool bluetooth_connection_service_peek(void);
+void bluetooth_connection_service_subscribe(BluetoothConnectionHandler handler);
+void bluetooth_connection_service_unsubscribe(void);
+
+typedef struct {
+  const uint32_t *durations;
+  uint32_t num_segments;
+} VibePattern;
+
+void vibes_enqueue_custom_pattern(VibePattern pattern);
+void vibes_short_pulse(void);
+void vibes_long_pulse(void);
+void vibes_double_pulse(void);
+
+typedef enum {
+  S_SUCCESS = 0,
+  E_ERROR = -1,
+  E_INVALID_ARGUMENT = -3,
+  E_DOES_NOT_EXIST = -4,
+  E_OUT_OF_STORAGE = -7,
+} StatusCode;
+
+#define PERSIST_DATA_MAX_LENGTH 256
+
+bool persist_exists(const uint32_t key);
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size);
+int persist_write_data(const uint32_t key, const void *data, const size_t size);
+StatusCode persist_delete(const uint32_t key);
+
+// Same layout as the SDK's, which is also the wire format.
+typedef enum {
+  TUPLE_BYTE_ARRAY = 0,
+  TUPLE_CSTRING = 1,
+  TUPLE_UINT = 2,
+  TUPLE_INT = 3,
+} TupleType;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t key;
+  TupleType type:8;
+  uint16_t length;
+  union {
+    uint8_t data[0];
+    char cstring[0];
+    uint8_t uint8;
+    uint16_t uint16;
+    uint32_t uint32;
+    int8_t int8;
+    int16_t int16;
+    int32_t int32;
+  } value[];
+} Tuple;
+
+typedef struct __attribute__((__packed__)) {
+  uint8_t count;
+  Tuple head[];
+} Dictionary;
+
+typedef struct {
+  Dictionary *dictionary;
+  const void *end;
+  Tuple *cursor;
+} DictionaryIterator;
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key);
+
+typedef enum {
+  APP_MSG_OK = 0,
+} AppMessageResult;
+
+typedef void (*AppMessageInboxReceived)(DictionaryIterator *iterator, void *context);
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound);
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback);
+
+#endif  // HOST_PEBBLE_H
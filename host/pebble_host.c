@@ -0,0 +1,384 @@
+// Host implementation of the small subset of the Pebble API declared
+// in pebble.h.  Resources are read from the project's resources/
+// directory, using the table generated from appinfo.json by
+// gen_resource_ids.py.
+
+#define HOST_NO_ALLOC_HOOKS 1
+#define HOST_NO_CLOCK_HOOKS 1
+#define HOST_NO_RAND_HOOKS 1
+#include <pebble.h>
+#include <stdarg.h>
+
+#include "resource_table.auto.h"
+
+#ifndef HOST_RESOURCE_DIR
+#define HOST_RESOURCE_DIR "../resources"
+#endif
+
+HostHeapStats host_heap_stats;
+size_t host_heap_limit = 0;
+
+// What heap_bytes_free() reports when there's no limit: plenty.
+#define HOST_UNLIMITED_HEAP_FREE (1 << 20)
+
+// Each allocation is prefixed with its size, so host_free() can keep
+// bytes_in_use honest.
+typedef union {
+  size_t size;
+  long double _align;
+} HostAllocHeader;
+
+void *host_malloc(size_t size) {
+  if (host_heap_limit != 0 && host_heap_stats.bytes_in_use + size > host_heap_limit) {
+    return NULL;
+  }
+  HostAllocHeader *header = (HostAllocHeader *)malloc(sizeof(HostAllocHeader) + size);
+  if (header == NULL) {
+    return NULL;
+  }
+  header->size = size;
+  host_heap_stats.allocs++;
+  host_heap_stats.bytes_allocated += size;
+  host_heap_stats.bytes_in_use += size;
+  if (host_heap_stats.bytes_in_use > host_heap_stats.peak_bytes_in_use) {
+    host_heap_stats.peak_bytes_in_use = host_heap_stats.bytes_in_use;
+  }
+  return header + 1;
+}
+
+void host_free(void *ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+  HostAllocHeader *header = (HostAllocHeader *)ptr - 1;
+  host_heap_stats.frees++;
+  host_heap_stats.bytes_in_use -= header->size;
+  free(header);
+}
+
+size_t heap_bytes_used(void) {
+  return host_heap_stats.bytes_in_use;
+}
+
+size_t heap_bytes_free(void) {
+  if (host_heap_limit == 0) {
+    return HOST_UNLIMITED_HEAP_FREE;
+  }
+  return (host_heap_stats.bytes_in_use < host_heap_limit) ? host_heap_limit - host_heap_stats.bytes_in_use : 0;
+}
+
+// The example generator from the C standard.
+static unsigned long host_rand_next = 1;
+
+int host_rand(void) {
+  host_rand_next = host_rand_next * 1103515245 + 12345;
+  return (unsigned int)(host_rand_next / 65536) % 32768;
+}
+
+void host_srand(unsigned int seed) {
+  host_rand_next = seed;
+}
+
+uint8_t host_log_level = APP_LOG_LEVEL_DEBUG_VERBOSE;
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...) {
+  if (log_level > host_log_level) {
+    return;
+  }
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "[%d] %s:%d: ", log_level, src_filename, src_line_number);
+  vfprintf(stderr, fmt, ap);
+  fprintf(stderr, "\n");
+  va_end(ap);
+}
+
+int64_t host_clock_ms = -1;
+
+static int64_t host_now_ms() {
+  if (host_clock_ms >= 0) {
+    return host_clock_ms;
+  }
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+time_t host_time(time_t *tloc) {
+  time_t seconds = host_now_ms() / 1000;
+  if (tloc != NULL) {
+    *tloc = seconds;
+  }
+  return seconds;
+}
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms) {
+  int64_t now_ms = host_now_ms();
+  uint16_t ms = now_ms % 1000;
+  if (tloc != NULL) {
+    *tloc = now_ms / 1000;
+  }
+  if (out_ms != NULL) {
+    *out_ms = ms;
+  }
+  return ms;
+}
+
+// A resource is loaded from disk the first time its handle is
+// requested, and then kept in memory for the life of the process, so
+// that benchmarks measure decoding rather than file I/O.
+typedef struct {
+  uint8_t *data;
+  size_t size;
+} HostResource;
+
+// The most files host_resource_add_file() may add.
+#define HOST_MAX_EXTRA_RESOURCES 8
+
+static HostResource host_resources[NUM_HOST_RESOURCES + HOST_MAX_EXTRA_RESOURCES];
+static const char *host_extra_resource_files[HOST_MAX_EXTRA_RESOURCES];
+static int host_num_extra_resources = 0;
+
+uint32_t host_resource_add_file(const char *filename) {
+  if (host_num_extra_resources >= HOST_MAX_EXTRA_RESOURCES) {
+    fprintf(stderr, "too many extra resources, at %s\n", filename);
+    abort();
+  }
+  host_extra_resource_files[host_num_extra_resources] = filename;
+  return NUM_HOST_RESOURCES + host_num_extra_resources++;
+}
+
+ResHandle resource_get_handle(uint32_t resource_id) {
+  if (resource_id == 0 || resource_id >= NUM_HOST_RESOURCES + host_num_extra_resources) {
+    fprintf(stderr, "invalid resource id %u\n", resource_id);
+    abort();
+  }
+
+  HostResource *res = &host_resources[resource_id];
+  if (res->data == NULL) {
+    char filename[512];
+    const char *file;
+    if (resource_id >= NUM_HOST_RESOURCES) {
+      file = host_extra_resource_files[resource_id - NUM_HOST_RESOURCES];
+    } else {
+      file = host_resource_files[resource_id];
+    }
+    if (resource_id >= NUM_HOST_RESOURCES || file[0] == '/') {
+      // A resource converted by gen_resource_ids.py, or an extra one.
+      snprintf(filename, sizeof(filename), "%s", file);
+    } else {
+      snprintf(filename, sizeof(filename), "%s/%s", HOST_RESOURCE_DIR, file);
+    }
+    FILE *f = fopen(filename, "rb");
+    if (f == NULL) {
+      perror(filename);
+      abort();
+    }
+    fseek(f, 0, SEEK_END);
+    res->size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    res->data = (uint8_t *)malloc(res->size);
+    if (fread(res->data, 1, res->size, f) != res->size) {
+      perror(filename);
+      abort();
+    }
+    fclose(f);
+  }
+
+  return res;
+}
+
+size_t resource_size(ResHandle h) {
+  return ((HostResource *)h)->size;
+}
+
+size_t resource_load_byte_range(ResHandle h, uint32_t start_offset, uint8_t *buffer, size_t num_bytes) {
+  HostResource *res = (HostResource *)h;
+  if (start_offset >= res->size) {
+    return 0;
+  }
+  if (num_bytes > res->size - start_offset) {
+    num_bytes = res->size - start_offset;
+  }
+  memcpy(buffer, res->data + start_offset, num_bytes);
+  return num_bytes;
+}
+
+// From bitmapgen.py; see also BitmapDataHeader in bwd.h.
+GBitmap *gbitmap_create_with_data(const uint8_t *data) {
+  GBitmap *bitmap = (GBitmap *)host_malloc(sizeof(GBitmap));
+  if (bitmap == NULL) {
+    return NULL;
+  }
+  const uint16_t *header = (const uint16_t *)data;
+  bitmap->row_size_bytes = header[0];
+  bitmap->info_flags = header[1];
+  bitmap->bounds = GRect((int16_t)header[2], (int16_t)header[3], (int16_t)header[4], (int16_t)header[5]);
+  bitmap->addr = (void *)(data + 12);
+  return bitmap;
+}
+
+// The resource is a pbi image: a BitmapDataHeader and its pixels.
+// gen_resource_ids.py converts the png resources into this form, as
+// the SDK does.  The GBitmap and its pixels share one allocation.
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id) {
+  ResHandle h = resource_get_handle(resource_id);
+  size_t size = resource_size(h);
+  GBitmap *bitmap = (GBitmap *)host_malloc(sizeof(GBitmap) + size);
+  if (bitmap == NULL) {
+    return NULL;
+  }
+  uint8_t *data = (uint8_t *)(bitmap + 1);
+  resource_load_byte_range(h, 0, data, size);
+  const uint16_t *header = (const uint16_t *)data;
+  bitmap->row_size_bytes = header[0];
+  bitmap->info_flags = header[1];
+  bitmap->bounds = GRect((int16_t)header[2], (int16_t)header[3], (int16_t)header[4], (int16_t)header[5]);
+  bitmap->addr = (void *)(data + 12);
+  return bitmap;
+}
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  host_free(bitmap);
+}
+
+bool grect_is_empty(const GRect *const rect) {
+  return rect->size.w <= 0 || rect->size.h <= 0;
+}
+
+void grect_clip(GRect *const rect_to_clip, const GRect *const rect_clipper) {
+  int x0 = rect_to_clip->origin.x;
+  int y0 = rect_to_clip->origin.y;
+  int x1 = x0 + rect_to_clip->size.w;
+  int y1 = y0 + rect_to_clip->size.h;
+  int cx0 = rect_clipper->origin.x;
+  int cy0 = rect_clipper->origin.y;
+  int cx1 = cx0 + rect_clipper->size.w;
+  int cy1 = cy0 + rect_clipper->size.h;
+  x0 = (x0 > cx0) ? x0 : cx0;
+  y0 = (y0 > cy0) ? y0 : cy0;
+  x1 = (x1 < cx1) ? x1 : cx1;
+  y1 = (y1 < cy1) ? y1 : cy1;
+  *rect_to_clip = GRect(x0, y0, (x1 > x0) ? x1 - x0 : 0, (y1 > y0) ? y1 - y0 : 0);
+}
+
+// The framebuffer has the same layout as the watch's: 1 bpp, with
+// rows padded to a whole number of words.  Like the watch's, it isn't
+// counted against the app's heap.
+GContext *host_gcontext_create(int width, int height) {
+  GContext *ctx = (GContext *)malloc(sizeof(GContext));
+  GBitmap *fb = (GBitmap *)malloc(sizeof(GBitmap));
+  fb->row_size_bytes = ((width + 31) / 32) * 4;
+  fb->info_flags = 0;
+  fb->bounds = GRect(0, 0, width, height);
+  fb->addr = malloc(fb->row_size_bytes * height);
+  memset(fb->addr, 0, fb->row_size_bytes * height);
+  ctx->framebuffer = fb;
+  ctx->draw_box = fb->bounds;
+  ctx->clip_box = fb->bounds;
+  ctx->compositing_mode = GCompOpAssign;
+  ctx->fill_color = GColorBlack;
+  ctx->text_color = GColorBlack;
+  ctx->framebuffer_captured = false;
+  return ctx;
+}
+
+void host_gcontext_destroy(GContext *ctx) {
+  free(ctx->framebuffer->addr);
+  free(ctx->framebuffer);
+  free(ctx);
+}
+
+// Moves rect from the coordinates of the layer being drawn to those
+// of the framebuffer, and returns the part of it that may be drawn.
+static GRect host_draw_rect(GContext *ctx, GRect *rect) {
+  rect->origin.x += ctx->draw_box.origin.x;
+  rect->origin.y += ctx->draw_box.origin.y;
+  GRect clip = *rect;
+  grect_clip(&clip, &ctx->clip_box);
+  grect_clip(&clip, &ctx->framebuffer->bounds);
+  return clip;
+}
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode) {
+  ctx->compositing_mode = mode;
+}
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+  ctx->fill_color = color;
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+  ctx->text_color = color;
+}
+
+static inline int host_get_pixel(const GBitmap *bitmap, int x, int y) {
+  const uint8_t *row = (const uint8_t *)bitmap->addr + y * bitmap->row_size_bytes;
+  return (row[x >> 3] >> (x & 7)) & 1;
+}
+
+static inline void host_set_pixel(GBitmap *bitmap, int x, int y, int value) {
+  uint8_t *row = (uint8_t *)bitmap->addr + y * bitmap->row_size_bytes;
+  if (value) {
+    row[x >> 3] |= (1 << (x & 7));
+  } else {
+    row[x >> 3] &= ~(1 << (x & 7));
+  }
+}
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask) {
+  if (ctx->fill_color == GColorClear) {
+    return;
+  }
+  rect = host_draw_rect(ctx, &rect);
+  for (int y = rect.origin.y; y < rect.origin.y + rect.size.h; ++y) {
+    for (int x = rect.origin.x; x < rect.origin.x + rect.size.w; ++x) {
+      host_set_pixel(ctx->framebuffer, x, y, ctx->fill_color == GColorWhite);
+    }
+  }
+}
+
+// A pixel-at-a-time model of the firmware's 1-bpp blitter: the bitmap
+// is tiled across rect from its bounds' origin, and each source pixel
+// is combined with the destination according to the compositing mode.
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect) {
+  GRect clip = host_draw_rect(ctx, &rect);
+  int bw = bitmap->bounds.size.w;
+  int bh = bitmap->bounds.size.h;
+  if (bw <= 0 || bh <= 0) {
+    return;
+  }
+  for (int y = clip.origin.y; y < clip.origin.y + clip.size.h; ++y) {
+    int sy = bitmap->bounds.origin.y + (y - rect.origin.y) % bh;
+    for (int x = clip.origin.x; x < clip.origin.x + clip.size.w; ++x) {
+      int sx = bitmap->bounds.origin.x + (x - rect.origin.x) % bw;
+      int s = host_get_pixel(bitmap, sx, sy);
+      int d = host_get_pixel(ctx->framebuffer, x, y);
+      switch (ctx->compositing_mode) {
+      case GCompOpAssign: d = s; break;
+      case GCompOpAssignInverted: d = !s; break;
+      case GCompOpOr: d = d | s; break;
+      case GCompOpAnd: d = d & s; break;
+      case GCompOpClear: d = d & !s; break;
+      case GCompOpSet: d = d | !s; break;
+      }
+      host_set_pixel(ctx->framebuffer, x, y, d);
+    }
+  }
+}
+
+GBitmap *graphics_capture_frame_buffer(GContext *ctx) {
+  if (ctx->framebuffer_captured) {
+    return NULL;
+  }
+  ctx->framebuffer_captured = true;
+  return ctx->framebuffer;
+}
+
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer) {
+  if (!ctx->framebuffer_captured || buffer != ctx->framebuffer) {
+    return false;
+  }
+  ctx->framebuffer_captured = false;
+  return true;
+}
@@ -0,0 +1,764 @@
+// Host implementation of the Pebble app framework: windows, layers,
+// timers, the tick, battery and Bluetooth services, vibes, persistent
+// storage and AppMessage.  Everything runs on the virtual clock in
+// host_clock_ms, which app_event_loop() advances straight to the next
+// thing that will happen, so a simulated day passes in a few seconds.
+// See sim.h.
+//
+// Like the SDK 2 firmware, we redraw the whole layer tree of the top
+// window whenever any layer is marked dirty, and leave the
+// framebuffer alone otherwise.
+
+#include <pebble.h>
+#include "sim.h"
+#include "bwd.h"
+
+SimConfig sim_config = {
+  0,
+  24 * 60 * 60 * 1000,
+  { 100, false, false },
+  true,
+  NULL,
+};
+
+SimStats sim_stats;
+
+static GContext *sim_ctx = NULL;
+static int64_t sim_start_ms;
+static bool sim_dirty = false;
+
+static double sim_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Layers.
+
+struct Layer {
+  GRect frame;
+  LayerUpdateProc update_proc;
+  Layer *parent;
+  Layer *first_child;
+  Layer *next_sibling;
+  GColor background_color;  // Drawn by the default update_proc.
+};
+
+// The update proc of a window's root layer, until the app sets its own.
+static void sim_root_layer_update(Layer *layer, GContext *ctx) {
+  if (layer->background_color != GColorClear) {
+    graphics_context_set_fill_color(ctx, layer->background_color);
+    graphics_fill_rect(ctx, layer_get_bounds(layer), 0, GCornerNone);
+  }
+}
+
+Layer *layer_create(GRect frame) {
+  Layer *layer = (Layer *)malloc(sizeof(Layer));
+  if (layer == NULL) {
+    return NULL;
+  }
+  memset(layer, 0, sizeof(Layer));
+  layer->frame = frame;
+  layer->background_color = GColorClear;
+  return layer;
+}
+
+static void sim_layer_remove_from_parent(Layer *layer) {
+  if (layer->parent == NULL) {
+    return;
+  }
+  Layer **link = &layer->parent->first_child;
+  while (*link != layer) {
+    link = &(*link)->next_sibling;
+  }
+  *link = layer->next_sibling;
+  layer->parent = NULL;
+  layer->next_sibling = NULL;
+}
+
+void layer_destroy(Layer *layer) {
+  if (layer == NULL) {
+    return;
+  }
+  sim_layer_remove_from_parent(layer);
+  for (Layer *child = layer->first_child; child != NULL; ) {
+    Layer *next = child->next_sibling;
+    child->parent = NULL;
+    child->next_sibling = NULL;
+    child = next;
+  }
+  free(layer);
+  sim_dirty = true;
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+  layer->update_proc = update_proc;
+}
+
+// Children are drawn in the order they were added, after their parent.
+void layer_add_child(Layer *parent, Layer *child) {
+  sim_layer_remove_from_parent(child);
+  Layer **link = &parent->first_child;
+  while (*link != NULL) {
+    link = &(*link)->next_sibling;
+  }
+  *link = child;
+  child->parent = parent;
+  sim_dirty = true;
+}
+
+void layer_mark_dirty(Layer *layer) {
+  sim_dirty = true;
+}
+
+GRect layer_get_frame(const Layer *layer) {
+  return layer->frame;
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+  return GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
+}
+
+// Windows.
+
+struct Window {
+  Layer *root_layer;
+  WindowHandlers handlers;
+  bool loaded;
+};
+
+static Window *sim_top_window = NULL;
+
+Window *window_create(void) {
+  Window *window = (Window *)malloc(sizeof(Window));
+  if (window == NULL) {
+    return NULL;
+  }
+  memset(window, 0, sizeof(Window));
+  window->root_layer = layer_create(GRect(0, 0, SIM_SCREEN_WIDTH, SIM_SCREEN_HEIGHT));
+  window->root_layer->update_proc = &sim_root_layer_update;
+  window->root_layer->background_color = GColorWhite;
+  return window;
+}
+
+void window_destroy(Window *window) {
+  if (window == sim_top_window) {
+    window_stack_pop_all(false);
+  }
+  layer_destroy(window->root_layer);
+  free(window);
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+  window->handlers = handlers;
+}
+
+void window_set_background_color(Window *window, GColor background_color) {
+  window->root_layer->background_color = background_color;
+}
+
+Layer *window_get_root_layer(const Window *window) {
+  return window->root_layer;
+}
+
+// We only have the one window, so there's no stack to speak of.
+void window_stack_push(Window *window, bool animated) {
+  if (sim_top_window != NULL) {
+    window_stack_pop_all(false);
+  }
+  sim_top_window = window;
+  if (!window->loaded) {
+    window->loaded = true;
+    if (window->handlers.load != NULL) {
+      window->handlers.load(window);
+    }
+  }
+  if (window->handlers.appear != NULL) {
+    window->handlers.appear(window);
+  }
+  sim_dirty = true;
+}
+
+void window_stack_pop_all(bool animated) {
+  Window *window = sim_top_window;
+  if (window == NULL) {
+    return;
+  }
+  sim_top_window = NULL;
+  if (window->handlers.disappear != NULL) {
+    window->handlers.disappear(window);
+  }
+  if (window->loaded) {
+    window->loaded = false;
+    if (window->handlers.unload != NULL) {
+      window->handlers.unload(window);
+    }
+  }
+}
+
+// Draws layer and its descendants, each clipped to its own frame and
+// its parent's.
+static void sim_render_layer(Layer *layer, GRect parent_box) {
+  GRect box = layer->frame;
+  box.origin.x += parent_box.origin.x;
+  box.origin.y += parent_box.origin.y;
+  GRect clip = box;
+  grect_clip(&clip, &parent_box);
+
+  if (layer->update_proc != NULL && !grect_is_empty(&clip)) {
+    sim_ctx->draw_box = box;
+    sim_ctx->clip_box = clip;
+    sim_ctx->compositing_mode = GCompOpAssign;
+    sim_ctx->fill_color = GColorBlack;
+    layer->update_proc(layer, sim_ctx);
+    sim_stats.layer_updates++;
+  }
+
+  for (Layer *child = layer->first_child; child != NULL; child = child->next_sibling) {
+    sim_render_layer(child, clip);
+  }
+}
+
+static void sim_render_if_dirty() {
+  if (!sim_dirty || sim_top_window == NULL) {
+    return;
+  }
+  sim_dirty = false;
+
+  double start_ns = sim_now_ns();
+  sim_render_layer(sim_top_window->root_layer, sim_ctx->framebuffer->bounds);
+  sim_ctx->draw_box = sim_ctx->framebuffer->bounds;
+  sim_ctx->clip_box = sim_ctx->framebuffer->bounds;
+  double render_ns = sim_now_ns() - start_ns;
+
+  sim_stats.renders++;
+  sim_stats.render_ns_total += render_ns;
+  if (render_ns > sim_stats.render_ns_max) {
+    sim_stats.render_ns_max = render_ns;
+  }
+  if (sim_config.frame_hook != NULL) {
+    sim_config.frame_hook(sim_ctx, (uint32_t)render_ns);
+  }
+}
+
+// Timers.  The app's timers, and the driver's events from
+// sim_schedule(), share one list.  Timers due at the same moment fire
+// in the order they were set.
+
+struct AppTimer {
+  int64_t deadline_ms;
+  uint32_t seq;
+  AppTimerCallback callback;
+  void *callback_data;
+  void (*sim_callback)(void);  // For sim_schedule().
+  AppTimer *next;
+};
+
+static AppTimer *sim_timers = NULL;
+static uint32_t sim_timer_seq = 0;
+
+static AppTimer *sim_timer_add(int64_t deadline_ms) {
+  AppTimer *timer = (AppTimer *)malloc(sizeof(AppTimer));
+  if (timer == NULL) {
+    return NULL;
+  }
+  memset(timer, 0, sizeof(AppTimer));
+  timer->deadline_ms = deadline_ms;
+  timer->seq = sim_timer_seq++;
+  timer->next = sim_timers;
+  sim_timers = timer;
+  return timer;
+}
+
+static bool sim_timer_remove(AppTimer *timer) {
+  for (AppTimer **link = &sim_timers; *link != NULL; link = &(*link)->next) {
+    if (*link == timer) {
+      *link = timer->next;
+      return true;
+    }
+  }
+  return false;
+}
+
+static AppTimer *sim_timer_earliest() {
+  AppTimer *earliest = NULL;
+  for (AppTimer *timer = sim_timers; timer != NULL; timer = timer->next) {
+    if (earliest == NULL || timer->deadline_ms < earliest->deadline_ms ||
+        (timer->deadline_ms == earliest->deadline_ms && timer->seq < earliest->seq)) {
+      earliest = timer;
+    }
+  }
+  return earliest;
+}
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+  AppTimer *timer = sim_timer_add(host_clock_ms + timeout_ms);
+  if (timer != NULL) {
+    timer->callback = callback;
+    timer->callback_data = callback_data;
+  }
+  return timer;
+}
+
+bool app_timer_reschedule(AppTimer *timer, uint32_t new_timeout_ms) {
+  if (!sim_timer_remove(timer)) {
+    // It has already fired, or been canceled.
+    return false;
+  }
+  timer->deadline_ms = host_clock_ms + new_timeout_ms;
+  timer->seq = sim_timer_seq++;
+  timer->next = sim_timers;
+  sim_timers = timer;
+  return true;
+}
+
+void app_timer_cancel(AppTimer *timer) {
+  if (sim_timer_remove(timer)) {
+    free(timer);
+  }
+}
+
+// Calls back the driver at_ms after the simulation starts.  These
+// events aren't counted against the app's heap.
+void sim_schedule(uint32_t at_ms, void (*callback)(void)) {
+  size_t heap_limit = host_heap_limit;
+  host_heap_limit = 0;
+  AppTimer *timer = sim_timer_add(sim_start_ms + at_ms);
+  host_heap_limit = heap_limit;
+  timer->sim_callback = callback;
+}
+
+// Fires the timers that are due now, but not any they set in turn,
+// even if those are due now too.
+static void sim_fire_timers() {
+  uint32_t seq_limit = sim_timer_seq;
+  AppTimer *timer = sim_timer_earliest();
+  while (timer != NULL && timer->deadline_ms <= host_clock_ms && timer->seq < seq_limit) {
+    sim_timer_remove(timer);
+    AppTimer fired = *timer;
+    free(timer);
+    if (fired.sim_callback != NULL) {
+      fired.sim_callback();
+    } else {
+      sim_stats.timers_fired++;
+      fired.callback(fired.callback_data);
+    }
+    timer = sim_timer_earliest();
+  }
+}
+
+// The tick service.
+
+static TickHandler sim_tick_handler = NULL;
+static TimeUnits sim_tick_units;
+static struct tm sim_tick_last;
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler) {
+  sim_tick_handler = handler;
+  sim_tick_units = tick_units;
+  time_t now = time(NULL);
+  sim_tick_last = *localtime(&now);
+}
+
+void tick_timer_service_unsubscribe(void) {
+  sim_tick_handler = NULL;
+}
+
+// Called on each second of virtual time.
+static void sim_tick() {
+  if (sim_tick_handler == NULL) {
+    return;
+  }
+  time_t now = time(NULL);
+  struct tm tm = *localtime(&now);
+  int changed = 0;
+  if (tm.tm_sec != sim_tick_last.tm_sec) changed |= SECOND_UNIT;
+  if (tm.tm_min != sim_tick_last.tm_min) changed |= MINUTE_UNIT;
+  if (tm.tm_hour != sim_tick_last.tm_hour) changed |= HOUR_UNIT;
+  if (tm.tm_mday != sim_tick_last.tm_mday) changed |= DAY_UNIT;
+  if (tm.tm_mon != sim_tick_last.tm_mon) changed |= MONTH_UNIT;
+  if (tm.tm_year != sim_tick_last.tm_year) changed |= YEAR_UNIT;
+  sim_tick_last = tm;
+
+  if (changed & sim_tick_units) {
+    sim_stats.ticks++;
+    sim_tick_handler(&tm, (TimeUnits)changed);
+  }
+}
+
+// The battery and Bluetooth services.
+
+static BatteryStateHandler sim_battery_handler = NULL;
+static BluetoothConnectionHandler sim_bluetooth_handler = NULL;
+
+BatteryChargeState battery_state_service_peek(void) {
+  return sim_config.battery;
+}
+
+void battery_state_service_subscribe(BatteryStateHandler handler) {
+  sim_battery_handler = handler;
+}
+
+void battery_state_service_unsubscribe(void) {
+  sim_battery_handler = NULL;
+}
+
+void sim_set_battery(BatteryChargeState battery) {
+  sim_config.battery = battery;
+  if (sim_battery_handler != NULL) {
+    sim_battery_handler(battery);
+  }
+}
+
+bool bluetooth_connection_service_peek(void) {
+  return sim_config.bluetooth_connected;
+}
+
+void bluetooth_connection_service_subscribe(BluetoothConnectionHandler handler) {
+  sim_bluetooth_handler = handler;
+}
+
+void bluetooth_connection_service_unsubscribe(void) {
+  sim_bluetooth_handler = NULL;
+}
+
+void sim_set_bluetooth(bool connected) {
+  sim_config.bluetooth_connected = connected;
+  if (sim_bluetooth_handler != NULL) {
+    sim_bluetooth_handler(connected);
+  }
+}
+
+// Vibes are just counted.
+
+void vibes_enqueue_custom_pattern(VibePattern pattern) {
+  sim_stats.vibes++;
+}
+
+void vibes_short_pulse(void) {
+  sim_stats.vibes++;
+}
+
+void vibes_long_pulse(void) {
+  sim_stats.vibes++;
+}
+
+void vibes_double_pulse(void) {
+  sim_stats.vibes++;
+}
+
+// Persistent storage, held in memory for the life of the process, so
+// it survives from one run of app_main() to the next.
+
+#define SIM_PERSIST_MAX_KEYS 16
+
+typedef struct {
+  bool used;
+  uint32_t key;
+  size_t size;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} SimPersist;
+
+static SimPersist sim_persist[SIM_PERSIST_MAX_KEYS];
+
+static SimPersist *sim_persist_find(uint32_t key) {
+  for (int i = 0; i < SIM_PERSIST_MAX_KEYS; ++i) {
+    if (sim_persist[i].used && sim_persist[i].key == key) {
+      return &sim_persist[i];
+    }
+  }
+  return NULL;
+}
+
+bool persist_exists(const uint32_t key) {
+  return sim_persist_find(key) != NULL;
+}
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+  SimPersist *p = sim_persist_find(key);
+  if (p == NULL) {
+    return E_DOES_NOT_EXIST;
+  }
+  size_t size = (p->size < buffer_size) ? p->size : buffer_size;
+  memcpy(buffer, p->data, size);
+  return size;
+}
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+  if (size > PERSIST_DATA_MAX_LENGTH) {
+    return E_INVALID_ARGUMENT;
+  }
+  SimPersist *p = sim_persist_find(key);
+  for (int i = 0; p == NULL && i < SIM_PERSIST_MAX_KEYS; ++i) {
+    if (!sim_persist[i].used) {
+      p = &sim_persist[i];
+    }
+  }
+  if (p == NULL) {
+    return E_OUT_OF_STORAGE;
+  }
+  p->used = true;
+  p->key = key;
+  p->size = size;
+  memcpy(p->data, data, size);
+  return size;
+}
+
+StatusCode persist_delete(const uint32_t key) {
+  SimPersist *p = sim_persist_find(key);
+  if (p == NULL) {
+    return E_DOES_NOT_EXIST;
+  }
+  p->used = false;
+  return S_SUCCESS;
+}
+
+// AppMessage.  Messages from the "phone" are delivered straight to the
+// inbox handler.
+
+static AppMessageInboxReceived sim_inbox_received = NULL;
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+  return APP_MSG_OK;
+}
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+  AppMessageInboxReceived previous = sim_inbox_received;
+  sim_inbox_received = received_callback;
+  return previous;
+}
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+  Tuple *tuple = iter->dictionary->head;
+  for (int i = 0; i < iter->dictionary->count; ++i) {
+    if (tuple->key == key) {
+      return tuple;
+    }
+    tuple = (Tuple *)((uint8_t *)tuple + sizeof(Tuple) + tuple->length);
+  }
+  return NULL;
+}
+
+// Sends the app a message of a single int32 tuple.
+void sim_send_int32(uint32_t key, int32_t value) {
+  if (sim_inbox_received == NULL) {
+    return;
+  }
+  uint8_t buffer[sizeof(Dictionary) + sizeof(Tuple) + sizeof(int32_t)];
+  Dictionary *dict = (Dictionary *)buffer;
+  dict->count = 1;
+  dict->head[0].key = key;
+  dict->head[0].type = TUPLE_INT;
+  dict->head[0].length = sizeof(int32_t);
+  memcpy(dict->head[0].value, &value, sizeof(int32_t));
+
+  DictionaryIterator iter;
+  iter.dictionary = dict;
+  iter.end = buffer + sizeof(buffer);
+  iter.cursor = dict->head;
+  sim_inbox_received(&iter, NULL);
+}
+
+// The event loop.
+
+// Runs the simulation until end_ms, or until until() returns true,
+// rendering after each event that dirties a layer.
+static void sim_loop(int64_t end_ms, bool (*until)(void)) {
+  sim_render_if_dirty();
+
+  while (until == NULL || !until()) {
+    int64_t next_ms = end_ms;
+    AppTimer *timer = sim_timer_earliest();
+    if (timer != NULL && timer->deadline_ms < next_ms) {
+      next_ms = timer->deadline_ms;
+    }
+    int64_t next_second_ms = (host_clock_ms / 1000 + 1) * 1000;
+    if (sim_tick_handler != NULL && next_second_ms < next_ms) {
+      next_ms = next_second_ms;
+    }
+    if (next_ms >= end_ms) {
+      host_clock_ms = end_ms;
+      break;
+    }
+
+    bool new_second = (next_ms / 1000 != host_clock_ms / 1000);
+    host_clock_ms = next_ms;
+    if (new_second) {
+      sim_tick();
+    }
+    sim_fire_timers();
+    sim_render_if_dirty();
+  }
+}
+
+// Runs the simulation until sim_config.duration_ms after it started.
+void app_event_loop(void) {
+  sim_loop(sim_start_ms + sim_config.duration_ms, NULL);
+}
+
+// Runs the simulation for up to duration_ms from now, stopping early
+// if until is given and returns true.  Returns true if it stopped
+// early.  For drivers that call into the app themselves, rather than
+// through app_main().
+bool sim_run(uint32_t duration_ms, bool (*until)(void)) {
+  sim_loop(host_clock_ms + duration_ms, until);
+  return until != NULL && until();
+}
+
+// Starts the virtual clock at sim_config.start_time, with a blank
+// screen.  Call this before app_main().
+void sim_init() {
+  sim_start_ms = (int64_t)sim_config.start_time * 1000;
+  host_clock_ms = sim_start_ms;
+  sim_ctx = host_gcontext_create(SIM_SCREEN_WIDTH, SIM_SCREEN_HEIGHT);
+  sim_dirty = false;
+  memset(&sim_stats, 0, sizeof(sim_stats));
+}
+
+// Releases the simulator's own resources, after app_main() returns.
+// Anything the app left behind is its own leak.
+void sim_deinit() {
+  while (sim_timers != NULL) {
+    AppTimer *timer = sim_timers;
+    sim_timers = timer->next;
+    free(timer);
+  }
+  sim_tick_handler = NULL;
+  sim_battery_handler = NULL;
+  sim_bluetooth_handler = NULL;
+  sim_inbox_received = NULL;
+  host_gcontext_destroy(sim_ctx);
+  sim_ctx = NULL;
+  host_clock_ms = -1;
+}
+
+// The firmware's fonts aren't available on the host.  The one the
+// watchface uses, Bitham 30 Black, is stood in for by the minutes
+// glyphs in resources/ (see make_glyphs.py): just the digits, the
+// colon and the space, spaced so that " %02d" and ":" land on the
+// cells of the minutes card, just where MINUTE_GLYPHS would blit the
+// same glyphs.  So the host draws the minutes the same either way,
+// though neither is quite what the watch draws.
+struct HostFont {
+  bool loaded;
+  BitmapWithData glyphs[11];  // '0' to '9', then ':'.
+};
+
+static struct HostFont sim_bitham_30_black;
+
+static const int sim_font_resource_ids[11] = {
+  RESOURCE_ID_DIGIT_0, RESOURCE_ID_DIGIT_1, RESOURCE_ID_DIGIT_2, RESOURCE_ID_DIGIT_3,
+  RESOURCE_ID_DIGIT_4, RESOURCE_ID_DIGIT_5, RESOURCE_ID_DIGIT_6, RESOURCE_ID_DIGIT_7,
+  RESOURCE_ID_DIGIT_8, RESOURCE_ID_DIGIT_9, RESOURCE_ID_COLON,
+};
+
+// The layout of the stand-in font, in pixels: the top of each glyph
+// below the top of the text box, the width of each glyph (the images
+// are encoded a whole number of bytes wide, with blank columns to
+// spare), and how far each character moves the pen along.  The colon
+// is inset by a pixel; anything that isn't a digit or a colon is
+// drawn as a space.
+#define SIM_FONT_TOP 8
+#define SIM_FONT_DIGIT_WIDTH 18
+#define SIM_FONT_DIGIT_ADVANCE 18
+#define SIM_FONT_COLON_LEFT 1
+#define SIM_FONT_COLON_WIDTH 7
+#define SIM_FONT_COLON_ADVANCE 8
+#define SIM_FONT_SPACE_ADVANCE 10
+
+// Decodes the glyphs, once, for the life of the process.  A system
+// font isn't the app's to pay for, so this is done with the heap
+// limit lifted, and the heap's books are put back afterwards.
+static void sim_font_load(struct HostFont *font) {
+  HostHeapStats heap_stats = host_heap_stats;
+  size_t heap_limit = host_heap_limit;
+  host_heap_limit = 0;
+  for (int i = 0; i < 11; ++i) {
+    font->glyphs[i] = rle_bwd_create(sim_font_resource_ids[i]);
+  }
+  host_heap_stats = heap_stats;
+  host_heap_limit = heap_limit;
+  font->loaded = true;
+}
+
+GFont fonts_get_system_font(const char *font_key) {
+  if (strcmp(font_key, FONT_KEY_BITHAM_30_BLACK) != 0) {
+    return NULL;
+  }
+  if (!sim_bitham_30_black.loaded) {
+    sim_font_load(&sim_bitham_30_black);
+  }
+  return &sim_bitham_30_black;
+}
+
+// Draws the text on one line from the left of the box, clipped to
+// it, in the text color; the overflow mode and alignment are ignored.
+void graphics_draw_text(GContext *ctx, const char *text, const GFont font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        const GTextLayoutCacheRef layout) {
+  if (font == NULL) {
+    return;
+  }
+  GCompOp mode = ctx->compositing_mode;
+  ctx->compositing_mode = (ctx->text_color == GColorBlack) ? GCompOpAnd : GCompOpSet;
+
+  int x = box.origin.x;
+  for (const char *c = text; *c != '\0'; ++c) {
+    GBitmap *glyph = NULL;
+    int left = 0;
+    int width = 0;
+    int advance = SIM_FONT_SPACE_ADVANCE;
+    if (*c >= '0' && *c <= '9') {
+      glyph = font->glyphs[*c - '0'].bitmap;
+      width = SIM_FONT_DIGIT_WIDTH;
+      advance = SIM_FONT_DIGIT_ADVANCE;
+    } else if (*c == ':') {
+      glyph = font->glyphs[10].bitmap;
+      left = SIM_FONT_COLON_LEFT;
+      width = SIM_FONT_COLON_WIDTH;
+      advance = SIM_FONT_COLON_ADVANCE;
+    }
+
+    if (glyph != NULL) {
+      GRect cell = GRect(x + left, box.origin.y + SIM_FONT_TOP, width, glyph->bounds.size.h);
+      GRect clip = cell;
+      grect_clip(&clip, &box);
+      if (!grect_is_empty(&clip)) {
+        GBitmap sub = *glyph;
+        sub.bounds = GRect(clip.origin.x - cell.origin.x, clip.origin.y - cell.origin.y,
+                           clip.size.w, clip.size.h);
+        graphics_draw_bitmap_in_rect(ctx, &sub, clip);
+      }
+    }
+    x += advance;
+  }
+  ctx->compositing_mode = mode;
+}
+
+GContext *sim_get_context() {
+  return sim_ctx;
+}
+
+// Writes the framebuffer as a binary pbm, in which 1 is black.
+bool sim_write_pbm(const char *filename) {
+  FILE *f = fopen(filename, "wb");
+  if (f == NULL) {
+    return false;
+  }
+  GBitmap *fb = sim_ctx->framebuffer;
+  int w = fb->bounds.size.w;
+  int h = fb->bounds.size.h;
+  fprintf(f, "P4\n%d %d\n", w, h);
+  for (int y = 0; y < h; ++y) {
+    const uint8_t *row = (const uint8_t *)fb->addr + y * fb->row_size_bytes;
+    for (int x = 0; x < w; x += 8) {
+      uint8_t out = 0;
+      for (int b = 0; b < 8 && x + b < w; ++b) {
+        int white = (row[(x + b) >> 3] >> ((x + b) & 7)) & 1;
+        out |= (!white) << (7 - b);
+      }
+      fputc(out, f);
+    }
+  }
+  return fclose(f) == 0;
+}
@@ -0,0 +1,53 @@
+#ifndef SIM_H
+#define SIM_H
+
+// The controls of the simulator in pebble_sim.c, which runs the app
+// against the host pebble.h on a virtual clock.  The app's main() is
+// renamed app_main() by the Makefile; a driver such as sim_main.c sets
+// up the simulation, then calls app_main(), whose app_event_loop()
+// runs the simulation until SimConfig.duration_ms of virtual time have
+// passed.  A driver may instead call into the app's functions itself,
+// and run the simulation between calls with sim_run().
+
+#include <pebble.h>
+
+#define SIM_SCREEN_WIDTH 144
+#define SIM_SCREEN_HEIGHT 168
+
+typedef void (*SimFrameHook)(GContext *ctx, uint32_t render_ns);
+
+typedef struct {
+  time_t start_time;         // The virtual time at which the app starts.
+  uint32_t duration_ms;      // How long app_event_loop() runs for.
+  BatteryChargeState battery;
+  bool bluetooth_connected;
+  SimFrameHook frame_hook;   // Called after each render, or NULL.
+} SimConfig;
+
+// The simulator's counters, for profiling.
+typedef struct {
+  unsigned long renders;
+  unsigned long layer_updates;
+  unsigned long timers_fired;
+  unsigned long ticks;
+  unsigned long vibes;
+  double render_ns_total;
+  double render_ns_max;
+} SimStats;
+
+extern SimConfig sim_config;
+extern SimStats sim_stats;
+
+void sim_init();
+void sim_deinit();
+GContext *sim_get_context();
+void sim_schedule(uint32_t at_ms, void (*callback)(void));
+bool sim_run(uint32_t duration_ms, bool (*until)(void));
+void sim_set_battery(BatteryChargeState battery);
+void sim_set_bluetooth(bool connected);
+void sim_send_int32(uint32_t key, int32_t value);
+bool sim_write_pbm(const char *filename);
+
+int app_main(void);
+
+#endif  // SIM_H
@@ -0,0 +1,222 @@
+// Runs the whole watchface in the simulator in pebble_sim.c, on a
+// virtual clock, and reports what it did and what it cost.  See the
+// Makefile for how to build and run this.
+//
+// sim [-s start] [-d duration] [-b percent[c|p]] [-B 0|1] [-c key=value]
+//     [-H bytes] [-o file.pbm] [-f dir]
+//
+//   -s start     When to start, as "YYYY-MM-DD HH:MM[:SS]" UTC, or
+//                seconds since the epoch (default 2014-01-01 11:59:50).
+//   -d duration  How long to run, in seconds, or with a suffix of s, m,
+//                h or d (default 1d).
+//   -b percent   The battery charge, with c if it's charging or p if
+//                it's just plugged in (default 100).
+//   -B 0|1       Whether Bluetooth is connected (default 1).
+//   -c key=value Sends the app a config message once it has started,
+//                as the phone would; key is one of the names in
+//                config_options.h, such as second_hand.  May be
+//                repeated.
+//   -H bytes     Limits the app's heap to this many bytes, so that
+//                allocations beyond it fail (default no limit).
+//   -o file.pbm  Writes the final framebuffer to this file.
+//   -f dir       Writes every rendered frame to dir/frame_NNNNNN.pbm.
+
+#define _GNU_SOURCE 1  // For strptime() and timegm().
+#include <pebble.h>
+#include <getopt.h>
+#include "sim.h"
+#include "config_options.h"
+#include "heap_stats.h"
+
+static const struct {
+  const char *name;
+  ConfigKey key;
+} sim_config_keys[] = {
+  { "keep_battery_gauge", CK_keep_battery_gauge },
+  { "keep_bluetooth_indicator", CK_keep_bluetooth_indicator },
+  { "second_hand", CK_second_hand },
+  { "hour_buzzer", CK_hour_buzzer },
+  { "hurt", CK_hurt },
+  { "low_power", CK_low_power },
+};
+#define NUM_SIM_CONFIG_KEYS (sizeof(sim_config_keys) / sizeof(sim_config_keys[0]))
+
+#define MAX_CONFIG_MESSAGES 16
+
+static struct {
+  uint32_t key;
+  int32_t value;
+} config_messages[MAX_CONFIG_MESSAGES];
+static int num_config_messages = 0;
+
+static const char *frame_dir = NULL;
+static unsigned long frame_count = 0;
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void send_config_messages() {
+  for (int i = 0; i < num_config_messages; ++i) {
+    sim_send_int32(config_messages[i].key, config_messages[i].value);
+  }
+}
+
+static void write_frame(GContext *ctx, uint32_t render_ns) {
+  char filename[512];
+  snprintf(filename, sizeof(filename), "%s/frame_%06lu.pbm", frame_dir, frame_count++);
+  if (!sim_write_pbm(filename)) {
+    perror(filename);
+    exit(1);
+  }
+}
+
+static bool parse_start(const char *arg, time_t *start) {
+  struct tm tm;
+  memset(&tm, 0, sizeof(tm));
+  const char *end = strptime(arg, "%Y-%m-%d %H:%M:%S", &tm);
+  if (end == NULL) {
+    memset(&tm, 0, sizeof(tm));
+    end = strptime(arg, "%Y-%m-%d %H:%M", &tm);
+  }
+  if (end != NULL && *end == '\0') {
+    *start = timegm(&tm);
+    return true;
+  }
+  char *num_end;
+  long seconds = strtol(arg, &num_end, 10);
+  if (num_end != arg && *num_end == '\0') {
+    *start = seconds;
+    return true;
+  }
+  return false;
+}
+
+static bool parse_duration(const char *arg, uint32_t *duration_ms) {
+  char *end;
+  double value = strtod(arg, &end);
+  double scale = 1;
+  switch (*end) {
+  case '\0': case 's': scale = 1; break;
+  case 'm': scale = 60; break;
+  case 'h': scale = 60 * 60; break;
+  case 'd': scale = 24 * 60 * 60; break;
+  default: return false;
+  }
+  if (end == arg || (*end != '\0' && end[1] != '\0') || value < 0 || value * scale > 40 * 24 * 60 * 60) {
+    return false;
+  }
+  *duration_ms = (uint32_t)(value * scale * 1000);
+  return true;
+}
+
+static bool parse_config(const char *arg) {
+  const char *equals = strchr(arg, '=');
+  if (equals == NULL || num_config_messages >= MAX_CONFIG_MESSAGES) {
+    return false;
+  }
+  for (size_t i = 0; i < NUM_SIM_CONFIG_KEYS; ++i) {
+    if (strlen(sim_config_keys[i].name) == (size_t)(equals - arg) &&
+        strncmp(sim_config_keys[i].name, arg, equals - arg) == 0) {
+      config_messages[num_config_messages].key = sim_config_keys[i].key;
+      config_messages[num_config_messages].value = atoi(equals + 1);
+      num_config_messages++;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [-s start] [-d duration] [-b percent[c|p]] [-B 0|1]\n"
+          "       [-c key=value] [-H bytes] [-o file.pbm] [-f dir]\n", argv0);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  // Local time is UTC, so runs are the same anywhere.
+  setenv("TZ", "UTC0", 1);
+  tzset();
+
+  struct tm start_tm = { .tm_year = 114, .tm_mon = 0, .tm_mday = 1, .tm_hour = 11, .tm_min = 59, .tm_sec = 50 };
+  sim_config.start_time = timegm(&start_tm);
+  const char *output_filename = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:d:b:B:c:H:o:f:")) != -1) {
+    switch (opt) {
+    case 's':
+      if (!parse_start(optarg, &sim_config.start_time)) usage(argv[0]);
+      break;
+    case 'd':
+      if (!parse_duration(optarg, &sim_config.duration_ms)) usage(argv[0]);
+      break;
+    case 'b': {
+      char *end;
+      sim_config.battery.charge_percent = strtol(optarg, &end, 10);
+      sim_config.battery.is_charging = (*end == 'c');
+      sim_config.battery.is_plugged = (*end == 'c' || *end == 'p');
+      break;
+    }
+    case 'B':
+      sim_config.bluetooth_connected = atoi(optarg) != 0;
+      break;
+    case 'c':
+      if (!parse_config(optarg)) usage(argv[0]);
+      break;
+    case 'H':
+      host_heap_limit = atol(optarg);
+      break;
+    case 'o':
+      output_filename = optarg;
+      break;
+    case 'f':
+      frame_dir = optarg;
+      sim_config.frame_hook = &write_frame;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind != argc) {
+    usage(argv[0]);
+  }
+
+  sim_init();
+  if (num_config_messages != 0) {
+    sim_schedule(1, &send_config_messages);
+  }
+
+  double start_ns = now_ns();
+  app_main();
+  double elapsed_ns = now_ns() - start_ns;
+
+  if (output_filename != NULL && !sim_write_pbm(output_filename)) {
+    perror(output_filename);
+    return 1;
+  }
+  sim_deinit();
+
+  printf("simulated %.1f hours in %.2f s\n", sim_config.duration_ms / 3600000.0, elapsed_ns / 1e9);
+  printf("renders        %lu, mean %.0f us, max %.0f us\n", sim_stats.renders,
+         sim_stats.renders ? sim_stats.render_ns_total / sim_stats.renders / 1000 : 0.0,
+         sim_stats.render_ns_max / 1000);
+  printf("layer updates  %lu\n", sim_stats.layer_updates);
+  printf("timers fired   %lu\n", sim_stats.timers_fired);
+  printf("ticks          %lu\n", sim_stats.ticks);
+  printf("vibes          %lu\n", sim_stats.vibes);
+  printf("heap           %lu allocs, peak %zu bytes, %zu bytes still in use\n",
+         host_heap_stats.allocs, host_heap_stats.peak_bytes_in_use, host_heap_stats.bytes_in_use);
+#ifdef HEAP_STATS
+  // Built with HEAP_STATS (as for "make heap-check"), any allocation
+  // the app couldn't make is a failure of the run.
+  int heap_failures = heap_stats_num_failures();
+  printf("heap failures  %d\n", heap_failures);
+  if (heap_failures != 0) {
+    return 1;
+  }
+#endif  // HEAP_STATS
+  return 0;
+}
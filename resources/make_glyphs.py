@@ -0,0 +1,154 @@
+#! /usr/bin/env python3
+
+import PIL.Image
+import sys
+import os
+import re
+import getopt
+
+help = """
+make_glyphs.py
+
+Writes the glyphs of the minutes, digit_0.png .. digit_9.png and
+colon.png, which make_rle.py then encodes like any other image, from
+a capture of the watch's own Bitham 30 Black.
+
+make_glyphs.py [opts] capture.log
+
+The watchface draws the minutes from these pre-rendered glyphs, but it
+used to draw them as text in Bitham 30 Black, one of the firmware's
+system fonts, which isn't available outside the firmware.  So the
+glyphs are captured from the firmware itself: build the watchface with
+GLYPH_CAPTURE defined (see src/doctors.c), and run it in the emulator,
+keeping its logs, for instance:
+
+    pebble install --emulator aplite --logs > capture.log
+
+It draws each digit and the colon just where the minutes and colon
+layers used to, and logs the pixels of each glyph's cell, one row to a
+line:
+
+    glyph digit_0 0 ......#######.....
+
+The capture is to be checked in as glyph_capture.log, alongside the
+PNGs written from it, so that -c ("make glyphs" in host/) can check
+that the two still agree.  The wscript doesn't run this.  No capture
+has been checked in yet: the PNGs are still stand-ins rendered from
+DejaVu Sans Bold at Bitham 30's digit height, which look a little
+different than the firmware's.  So until the capture replaces them,
+the watchface is built without MINUTE_GLYPHS, and draws the minutes
+as text in Bitham 30 Black, as it always has.
+
+On the host, which has no Bitham, the simulator draws the minutes from
+the stand-ins instead; "make glyph-capture" runs the capture build
+there and checks the result with -c, which exercises the capture and
+this script end to end, if not the font.
+
+Options:
+
+    -c
+        Rather than writing the PNGs, check that the ones already in
+        the output directory match the capture, and exit with status
+        1 if any of them don't.
+
+    -o dir
+        The directory of the PNGs (default the directory holding this
+        script).
+"""
+
+GLYPH_HEIGHT = 21
+GLYPHS = [('digit_%d' % (i), 18) for i in range(10)] + [('colon', 7)]
+
+def usage(code, msg = ''):
+    print(help, file = sys.stderr)
+    print(msg, file = sys.stderr)
+    sys.exit(code)
+
+def read_capture(filename):
+    """ Returns a dictionary of the rows of each glyph in the capture,
+    each a string of '#' and '.', from the last time each row was
+    logged.  Anything else in the log is ignored. """
+
+    pattern = re.compile(r'glyph (\w+) (\d+) ([#.]+)\s*$')
+    rows = {}
+    for line in open(filename):
+        match = pattern.search(line)
+        if match:
+            name, y, pixels = match.groups()
+            rows.setdefault(name, {})[int(y)] = pixels
+
+    glyphs = {}
+    for name, width in GLYPHS:
+        glyph_rows = rows.get(name, {})
+        if sorted(glyph_rows.keys()) != list(range(GLYPH_HEIGHT)):
+            raise ValueError('%s: %s is missing rows; capture it again' % (filename, name))
+        for y, pixels in glyph_rows.items():
+            if len(pixels) != width:
+                raise ValueError('%s: row %d of %s is %d pixels, not %d' % (filename, y, name, len(pixels), width))
+        glyphs[name] = [glyph_rows[y] for y in range(GLYPH_HEIGHT)]
+    return glyphs
+
+def make_image(glyph_rows):
+    """ Returns the glyph as a 1-bit image, black on white. """
+
+    width = len(glyph_rows[0])
+    image = PIL.Image.new('1', (width, GLYPH_HEIGHT), 1)
+    for y, pixels in enumerate(glyph_rows):
+        for x, pixel in enumerate(pixels):
+            if pixel == '#':
+                image.putpixel((x, y), 0)
+    return image
+
+def same_pixels(a, b):
+    """ Returns true if the two images have the same size and the same
+    black and white pixels. """
+
+    if a.size != b.size:
+        return False
+    a = a.convert('L').point(lambda v: 255 if v >= 128 else 0)
+    b = b.convert('L').point(lambda v: 255 if v >= 128 else 0)
+    return a.tobytes() == b.tobytes()
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], 'co:h')
+    except getopt.error as msg:
+        usage(1, msg)
+
+    check = False
+    outputDir = os.path.dirname(os.path.abspath(__file__))
+    for opt, arg in opts:
+        if opt == '-c':
+            check = True
+        elif opt == '-o':
+            outputDir = arg
+        elif opt == '-h':
+            usage(0)
+    if len(args) != 1:
+        usage(1, 'expected one capture log')
+
+    try:
+        glyphs = read_capture(args[0])
+    except (IOError, ValueError) as e:
+        print(e, file = sys.stderr)
+        sys.exit(1)
+
+    mismatched = []
+    for name, width in GLYPHS:
+        pathname = os.path.join(outputDir, name + '.png')
+        image = make_image(glyphs[name])
+        if not check:
+            image.save(pathname)
+            print(pathname)
+        elif not os.path.exists(pathname) or not same_pixels(image, PIL.Image.open(pathname)):
+            mismatched.append(pathname)
+
+    if mismatched:
+        for pathname in mismatched:
+            print('%s: does not match the capture' % (pathname), file = sys.stderr)
+        sys.exit(1)
+    if check:
+        print('all %d glyphs match %s' % (len(GLYPHS), args[0]))
+
+if __name__ == '__main__':
+    main()
@@ -1,9 +1,19 @@
-#! /usr/bin/env python
+#! /usr/bin/env python3
 
-import PIL.Image
 import sys
 import os
 import getopt
+import json
+import hashlib
+import multiprocessing
+
+# Only encoding needs these; -n, which merely compares hashes, doesn't,
+# so that the build can run it without them.
+try:
+    import PIL.Image
+    import numpy
+except ImportError:
+    numpy = None
 
 help = """
 make_rle.py
@@ -11,116 +21,267 @@ make_rle.py
 Converts an image from a standard format (for instance, a png) into an
 .rle file for loading pre-compressed into a Pebble watch app.
 
-make_rle.py [opts]
-        
+make_rle.py [opts] image [image ...]
+make_rle.py [opts] -a atlases.json
+make_rle.py -R report.json file.rle|file.atlas [...]
+
+Each image is encoded every way that is allowed--each format that the
+options permit, each with every chunk width n of 1, 2, 4 and 8--and
+the encoding with the lowest score is written, where the score is the
+size in bytes plus weight times the estimated number of decode
+operations (see estimate_decode_ops()).  By default, both a plain
+(format 0) and a row-delta (format 2) encoding are tried.
+
+This is normally run by the wscript's rle command ("waf rle"), on the
+images listed in its RLE_IMAGES, whenever an image changes; the .rle
+and .atlas files it writes are checked in, along with the cache of
+resources/rle_cache.json (see -c).  The build itself only runs it
+with -n, to fail if any of them is out of date.  It needs Python 3,
+and to encode anything, Pillow and numpy.
+
+Options:
+
+    -r rows
+        Write a row-indexed (format 1) .rle file, in which the runs
+        restart every "rows" rows, and an index of the byte offset of
+        each such band follows the header.  Each band can then be
+        decoded on its own.
+
+    -x
+        Also write a horizontally mirrored copy of each image, as
+        basename_x.rle, so the watch can load a sprite already facing
+        the other way instead of flipping it at runtime.  The mirror
+        is taken after the width is padded to a multiple of 8, so the
+        padding ends up on the left; bitmap_flip_x() in
+        src/bitmap_transform.c mirrors within the image's own width,
+        so the two agree only for widths that are a multiple of 8, as
+        the sprites' are.
+
+    -p
+        Write only a plain (format 0) .rle file, which must be decoded
+        all in one pass.
+
+    -d
+        Write only a row-delta (format 2) .rle file, in which each
+        row may first be XORed with one of the MAX_ROW_REF rows above
+        it, whichever packs smallest; a row that repeats an earlier
+        one becomes a single run of zeroes.  This suits the dithered
+        faces, whose rows resemble their neighbors more than they
+        resemble a run of a single color.  Such a file can only be
+        decoded as a whole.
+
+    -a atlases.json
+        Instead of encoding each image into its own .rle file, write
+        the sprite atlases described in atlases.json, each a single
+        resource holding all of one sprite's frames and masks; see
+        below.  -x doesn't apply; an atlas says for itself whether it
+        has a mirrored copy.
+
+    -w weight
+        The weight of a decode operation against a byte of the file,
+        in the score (default %s).  0 chooses by size alone.
+
+    -j jobs
+        Encode this many images at once (default: the number of
+        cores).
+
+    -c cache.json
+        Skip each image whose contents, options and encoder are the
+        same as when the cache was last written, as long as its .rle
+        files are still as they were written; and record the images
+        that were encoded this time.
+
+    -n
+        Encode nothing, and write nothing: only check, against the
+        cache given with -c, that each image is up to date, as above.
+        Lists each one that isn't and exits with status 1 if there
+        are any.
+
+    -R report.json
+        Also write a report of each .rle file, as JSON: its size, its
+        ratio against the raw stride * height bitmap, its estimated
+        decode operations, and the same for each encoding that was
+        tried.  Given .rle or .atlas files instead of images, reports
+        on those files as they are, without encoding anything; for
+        instance, "make_rle.py -R report.json *.rle *.atlas" covers
+        all of resources/.
+
+The file begins with a 4-byte header: w, h, stride, and a byte whose
+low 4 bits are n, the chunk width (see pack_rle()), and whose high 4
+bits are the format.  Format 0 follows this with a single run
+sequence for the whole image.  Format 1 follows it with band_rows,
+num_bands, num_bands 16-bit little-endian offsets (relative to the
+end of this index), and then the run sequence of each band.  Format
+2 follows it with the run sequence of the whole image after each row
+has been XORed with its reference row, including the final run, and
+then one value per row in the same encoding: 1 for a row stored as it
+is, or 1 + d for a row XORed with the row d above it.
+
+An atlases.json file maps the filename of each atlas to write to its
+description, for instance:
+
+    "k9.atlas" : {
+        "cx" : 41,
+        "mask" : "k9_mask.png",
+        "frames" : [ "k9.png" ],
+        "mirror" : true
+    }
+
+cx is the horizontal center of the sprite, mask is the image of its
+mask, and frames are the images of its animation, in order.  A frame
+may instead be written { "image" : "tardis_04.png", "flip_x" : true }
+to have the watch mirror the image as it draws it, so that the image
+is stored just once.  If mirror is true, the atlas also holds a
+mirrored copy of the sprite, for wipes in the other direction, as -x
+would write.
+
+An atlas file begins with a 4-byte header: num_images, num_frames,
+num_facings (1, or 2 with a mirrored copy), and a zero byte.  Then
+come num_images 16-bit little-endian offsets of the images, from the
+start of the file; then, for each facing, its cx, the image of its
+mask, and one byte per frame, the frame's image, plus 0x80 if the
+frame is to be flipped.  Then come the images, each an .rle file as
+above, except that a format 0 image includes its final run, since it
+doesn't end at the end of the file.
+
 """
 
+# The farthest row above that a format 2 row may be XORed with.
+MAX_ROW_REF = 16
+
+# The limits of an atlas; see ATLAS_MAX_IMAGES and ATLAS_MAX_FRAMES
+# in sprite_atlas.h.
+ATLAS_MAX_IMAGES = 12
+ATLAS_MAX_FRAMES = 8
+ATLAS_FLIP_X = 0x80
+
+# The chunk widths that pack_rle() and the decoder support.
+CHUNK_WIDTHS = [1, 2, 4, 8]
+
+# The default weight of a decode operation, in bytes.  A face has
+# around 10,000 runs either way, so this mostly breaks ties in favor
+# of the encoding with fewer runs.
+DEFAULT_WEIGHT = 0.01
+
 def usage(code, msg = ''):
-    print >> sys.stderr, help
-    print >> sys.stderr, msg
+    print(help % (DEFAULT_WEIGHT), file = sys.stderr)
+    print(msg, file = sys.stderr)
     sys.exit(code)
 
-def generate_pixels(image, stride):
-    """ This generator yields a sequence of 0/255 values for the pixels
-    of the image.  We extend the row to stride * 8 pixels. """
-    
-    w, h = image.size
-    for y in range(h):
-        for x in range(w):
-            value = image.getpixel((x, y))
-            yield value
-        for x in range(w, stride * 8):
-            # Pad out the row with zeroes.
-            yield 0
-
-    raise StopIteration
-
-def generate_rle(source):
-    """ This generator yields a sequence of run lengths of a binary
-    input--the input is either 0 or 255, so the rle is a simple sequence
-    of positive numbers representing alternate values, and explicit
-    values are not necessary. """
-
-    current = 0
-    count = 0
-    # We start with an implicit black pixel, which isn't actually part
-    # of the image.  The decoder must discard this pixel.  This
-    # implicit black pixel ensures that there are no 0 counts anywhere
-    # in the resulting data.
-    next = 0
-    while True:
-        while current == next:
-            count += 1
-            next = source.next()
-        yield count
-        current = next
-        count = 0
-
-def count_bits(num):
-    count = 0
-    while num >= (1 << count):
-        count += 1
-    return count
-
-def chop_rle(source, n):
-    """ Separates the rle sequence into a sequence of n-bit chunks.
-    If a value is too large to fit into a single chunk, a series of
-    0-valued chunks will introduce it. """
-    
-    result = ''
-    for v in source:
-        # Count the minimum number of chunks we need to represent v.
-        numChunks = (count_bits(v) + n - 1) / n
-
-        # We write out a number of zeroes to indicate this.
-        zeroCount = numChunks - 1
-        for z in range(zeroCount):
-            yield 0
-            
-        mask = (1 << n) - 1
-        for x in range(numChunks):
-            b = (v >> ((numChunks - x - 1) * n)) & mask
-            assert b != 0 or x != 0
-            yield b
-
-def pack_rle(source, n):
-    """ Packs a sequence of n-bit chunks into a byte string. """
-    seq = list(source)
-    result = ''
-    if n == 1:
-        seq += [0, 0, 0, 0, 0, 0, 0]
-        for i in range(0, len(seq) - 7, 8):
-            v = (seq[i + 0] << 7) | (seq[i + 1] << 6) | (seq[i + 2] << 5) | (seq[i +3] << 4) | (seq[i + 4] << 3) | (seq[i + 5] << 2) | (seq[i + 6] << 1) | (seq[i + 7])
-            result += (chr(v))
-    elif n == 2:
-        seq += [0, 0, 0]
-        for i in range(0, len(seq) - 3, 4):
-            v = (seq[i + 0] << 6) | (seq[i + 1] << 4) | (seq[i + 2] << 2) | (seq[i + 3])
-            result += (chr(v))
-    elif n == 4:
-        seq += [0]
-        for i in range(0, len(seq) - 1, 2):
-            v = (seq[i + 0] << 4) | (seq[i + 1])
-            result += (chr(v))
-    elif n == 8:
-        for v in seq:
-            result += chr(v)
-    else:
-        raise ValueError
+def image_rows(image, stride):
+    """ Returns the pixels of the image as an array of rows of 0/1
+    values, each extended with zeroes to stride * 8 pixels. """
 
-    return result
+    w, h = image.size
+    rows = numpy.zeros((h, stride * 8), dtype = numpy.uint8)
+    rows[:, :w] = numpy.asarray(image, dtype = numpy.uint8) != 0
+    return rows
+
+def run_lengths(rows):
+    """ Returns the run lengths of each row of 0/1 values in the
+    indicated 2-d array, as (lengths, row_of), where lengths is one
+    array of the runs of all of the rows in turn, and row_of gives the
+    row of each.
+
+    The input is binary, so the runs are a simple sequence of positive
+    numbers representing alternate values, and explicit values are not
+    necessary.  Each row starts with an implicit black pixel, which
+    isn't actually part of the image; the decoder must discard this
+    pixel.  This implicit black pixel ensures that there are no 0
+    counts anywhere in the resulting data. """
+
+    num_rows, width = rows.shape
+    pixels = numpy.zeros((num_rows, width + 1), dtype = numpy.uint8)
+    pixels[:, 1:] = rows
+
+    # A run begins at the implicit pixel and at each change of value,
+    # and the last run of each row ends just past its last pixel.
+    bounds = numpy.ones((num_rows, width + 2), dtype = bool)
+    bounds[:, 1:width + 1] = pixels[:, 1:] != pixels[:, :-1]
+    row_of, col = numpy.nonzero(bounds)
+    same_row = row_of[1:] == row_of[:-1]
+    return numpy.diff(col)[same_row], row_of[1:][same_row]
+
+def generate_rle(pixels, final = False):
+    """ Returns the run lengths of a 1-d array of 0/1 values, as a
+    list, beginning with the implicit black pixel (see run_lengths()).
+    The last run is omitted unless final is True; the decoder leaves
+    it black, which is harmless as long as the last run is row
+    padding. """
+
+    lengths, row_of = run_lengths(pixels.reshape(1, -1))
+    lengths = lengths.tolist()
+    if not final:
+        lengths = lengths[:-1]
+    return lengths
+
+def count_bits(values):
+    """ Returns the number of bits in each of the array of positive
+    values. """
+
+    return numpy.frexp(numpy.asarray(values, dtype = numpy.float64))[1]
+
+def delta_rows(rows):
+    """ Chooses a reference row for each row of 0/1 values, and returns
+    (refs, residual), where refs is the list of per-row values to
+    write (see the help) and residual is the array of the rows after
+    they have been XORed with their references.
+
+    The rows are chosen by the estimated number of bits each takes to
+    write, with 1-bit chunks (see pack_rle()), which is what the faces
+    end up using: a run or reference of v costs 2 * count_bits(v) - 1
+    bits.  Ties go to the nearest reference. """
+
+    h, width = rows.shape
+    deltas = numpy.empty((MAX_ROW_REF + 1, h, width), dtype = numpy.uint8)
+    deltas[0] = rows
+    for d in range(1, MAX_ROW_REF + 1):
+        deltas[d] = rows
+        if d < h:
+            deltas[d, d:] ^= rows[:h - d]
+
+    lengths, row_of = run_lengths(deltas.reshape(-1, width))
+    costs = numpy.bincount(row_of, weights = 2 * count_bits(lengths) - 1,
+                           minlength = (MAX_ROW_REF + 1) * h).reshape(MAX_ROW_REF + 1, h)
+    for d in range(1, MAX_ROW_REF + 1):
+        costs[d] += 2 * count_bits(1 + d) - 1
+        costs[d, :d] = numpy.inf
+    costs[0] += 1
+
+    best = numpy.argmin(costs, axis = 0)
+    return (best + 1).tolist(), deltas[best, numpy.arange(h)]
+
+def pack_rle(values, n):
+    """ Packs a sequence of positive values into a byte string of n-bit
+    chunks.  Each value is written in as few chunks as will hold it,
+    most significant first; if that's more than one, a series of
+    0-valued chunks, one fewer than the value's chunks, introduces
+    it.  The last byte is padded out with 0-valued chunks. """
+
+    values = numpy.asarray(values, dtype = numpy.int64)
+    num_chunks = (count_bits(values) + n - 1) // n
+    value_bits = num_chunks * n
+    total_bits = (2 * num_chunks - 1) * n
+    value_start = numpy.cumsum(total_bits) - total_bits + (num_chunks - 1) * n
+
+    # The position of each bit of each value, and the bit itself.
+    first = numpy.repeat(numpy.cumsum(value_bits) - value_bits, value_bits)
+    within = numpy.arange(first.size) - first
+    shift = numpy.repeat(value_bits, value_bits) - 1 - within
+    bits = numpy.zeros(int(total_bits.sum()), dtype = numpy.uint8)
+    bits[numpy.repeat(value_start, value_bits) + within] = (numpy.repeat(values, value_bits) >> shift) & 1
+    return numpy.packbits(bits).tobytes()
 
 class Rl2Unpacker:
-    """ This class reverses chop_rle() and pack_rle()--it reads a
-    string and returns the original rle sequence of positive integers.
-    It's written using a class and a call interface instead of as a
-    generator, so it can serve as a prototype for the C code to do the
-    same thing. """
+    """ This class reverses pack_rle()--it reads a string and returns
+    the original rle sequence of positive integers.  It's written using
+    a class and a call interface instead of as a generator, so it can
+    serve as a prototype for the C code to do the same thing. """
 
     def __init__(self, str, n):
         # assumption: n is an integer divisor of 8.
-        assert n * (8 / n) == 8
-          
+        assert n * (8 // n) == 8
+
         self.str = str
         self.n = n
         self.si = 0
@@ -140,10 +301,10 @@ class Rl2Unpacker:
 
         if self.si >= len(self.str):
             return 0
-        
+
         # First, count the number of zero chunks until we come to a nonzero chunk.
         zeroCount = 0
-        b = ord(self.str[self.si])
+        b = self.str[self.si]
         bmask = (1 << self.n) - 1
         bv = b & (bmask << (self.bi - self.n))
         while bv == 0:
@@ -154,8 +315,8 @@ class Rl2Unpacker:
                 self.bi = 8
                 if self.si >= len(self.str):
                     return 0
-                
-                b = ord(self.str[self.si])
+
+                b = self.str[self.si]
             bv = b & (bmask << (self.bi - self.n))
 
         # Infer from that the number of chunks, and hence the number
@@ -177,7 +338,7 @@ class Rl2Unpacker:
                 b = 0
                 break
 
-            b = ord(self.str[self.si])
+            b = self.str[self.si]
 
         if bitCount > 0:
             # A partial word in the middle of the byte.
@@ -189,64 +350,481 @@ class Rl2Unpacker:
             self.bi -= bitCount
 
         return result
-            
-            
-def make_rle(filename):
+
+def estimate_decode_ops(runs, stride, refs, data_size):
+    """ Estimates the work of rle_decode_into() for the indicated list
+    of rle sequences (one per band, each beginning with its implicit
+    black pixel) and the list of format 2 row references (empty for
+    other formats), when they pack into data_size bytes.  Each value
+    unpacked, each word filled by a run of 1-bits, each word XORed by
+    a row reference, and each word of input read counts as one
+    operation. """
+
+    ops = (data_size + 3) // 4
+    for band in runs:
+        lengths = numpy.asarray(band, dtype = numpy.int64)
+        start = numpy.cumsum(lengths) - lengths - 1
+        ones = slice(1, None, 2)
+        ops += len(band) + int(((start[ones] + lengths[ones] - 1) // 32 - start[ones] // 32 + 1).sum())
+
+    ops += len(refs) + sum(1 for ref in refs if ref > 1) * (stride // 4)
+    return ops
+
+def encode_candidates(image, stride, formats, band_rows, final = False):
+    """ Encodes the image, which has already been padded to a multiple
+    of 8 pixels wide, in each of the indicated formats with each chunk
+    width.  If final is True, a format 0 encoding includes its final
+    run, as it must within an atlas.  Returns a list of candidates,
+    each a dictionary. """
+
+    w, h = image.size
+    rows = image_rows(image, stride)
+    candidates = []
+    for format in formats:
+        refs = []
+        if format == 0:
+            # One run sequence for the whole image.
+            runs = [generate_rle(rows, final = final)]
+            sequences = runs
+        elif format == 1:
+            # A separate run sequence for each band of rows, including
+            # its final run, since the decoder stops at the end of the
+            # band rather than at the end of the data.
+            band_rows = min(band_rows, h)
+            runs = [generate_rle(rows[y0:y0 + band_rows], final = True) for y0 in range(0, h, band_rows)]
+            sequences = runs
+        else:
+            # The run sequence of the residual image, including its
+            # final run so that the decoder knows where the row
+            # references begin, followed by the references themselves.
+            refs, residual = delta_rows(rows)
+            runs = [generate_rle(residual, final = True)]
+            sequences = [runs[0] + refs]
+
+        for n in CHUNK_WIDTHS:
+            packed = [pack_rle(r, n) for r in sequences]
+            index = b''
+            if format == 1:
+                index = bytes([band_rows, len(packed)])
+                offset = 0
+                for band in packed:
+                    assert offset <= 0xffff
+                    index += bytes([offset & 0xff, offset >> 8])
+                    offset += len(band)
+
+            data = b''.join(packed)
+            candidates.append({
+                'format' : format,
+                'n' : n,
+                'sequences' : sequences,
+                'packed' : packed,
+                'rle' : bytes([w, h, stride, (format << 4) | n]) + index + data,
+                'decode_ops' : estimate_decode_ops(runs, stride, refs, len(data)),
+                })
+    return candidates
+
+def score_candidate(candidate, weight):
+    candidate['bytes'] = len(candidate['rle'])
+    candidate['score'] = candidate['bytes'] + weight * candidate['decode_ops']
+    return candidate['score']
+
+def report_entry(rleFilename, w, h, stride, chosen, candidates):
+    """ Returns the report of a .rle file, for -R. """
+
+    raw = h * stride
+    entry = {
+        'file' : os.path.basename(rleFilename),
+        'width' : w,
+        'height' : h,
+        'raw_bytes' : raw,
+        'bytes' : chosen['bytes'],
+        'ratio' : round(float(chosen['bytes']) / raw, 4),
+        'format' : chosen['format'],
+        'n' : chosen['n'],
+        'decode_ops' : chosen['decode_ops'],
+        }
+    if candidates:
+        entry['candidates'] = [{
+            'format' : c['format'],
+            'n' : c['n'],
+            'bytes' : c['bytes'],
+            'decode_ops' : c['decode_ops'],
+            'score' : round(c['score'], 2),
+            } for c in candidates]
+    return entry
+
+def load_image(filename):
+    """ Reads the indicated image as 1-bit pixels, padded to a multiple
+    of 8 pixels wide. """
+
     image = PIL.Image.open(filename)
     image = image.convert('1')
     w, h = image.size
-    stride = ((w + 31) / 32) * 4
-    fullSize = h * stride
-    
+
     if w % 8 != 0:
         # Must be a multiple of 8 pixels wide.  If not, expand it.
-        w = ((w + 7) / 8) * 8
+        w = ((w + 7) // 8) * 8
         im2 = PIL.Image.new('1', (w, h), 0)
         im2.paste(image, (0, 0))
         image = im2
-                            
+
     assert w <= 0xff and h <= 0xff
+    return image
+
+def make_rle(filename, formats, band_rows, mirror, weight):
+    """ Encodes the indicated image, and its mirror if mirror is True.
+    Returns a list of (rleFilename, summary, report entry) for the .rle
+    files written. """
+
+    image = load_image(filename)
+    w, h = image.size
+    basename = os.path.splitext(filename)[0]
+    results = [write_rle(image, basename + '.rle', formats, band_rows, weight)]
+    if mirror:
+        image = image.transpose(PIL.Image.FLIP_LEFT_RIGHT)
+        results.append(write_rle(image, basename + '_x.rle', formats, band_rows, weight))
+    return results
+
+def encode_best(image, formats, band_rows, weight, final = False):
+    """ Encodes the image, which has already been padded to a multiple
+    of 8 pixels wide, every way that is allowed (see
+    encode_candidates()), and returns (stride, chosen, candidates),
+    where chosen is the candidate with the lowest score. """
+
+    w, h = image.size
 
     # The number of bytes in a row.  Must be a multiple of 4, per
     # Pebble conventions.
-    stride = ((w + 31) / 32) * 4
+    stride = ((w + 31) // 32) * 4
     assert stride <= 0xff
 
-    # Find the best n for this image.
-    result = None
-    n = None
-    for n0 in [1, 8]:
-        result0 = pack_rle(chop_rle(generate_rle(generate_pixels(image, stride)), n0), n0)
-        if result is None or len(result0) < len(result):
-            result = result0
-            n = n0
+    candidates = encode_candidates(image, stride, formats, band_rows, final)
+    chosen = min(candidates, key = lambda c: score_candidate(c, weight))
 
     # Verify the result matches.
-    unpacker = Rl2Unpacker(result, n)
-    verify = unpacker.getList()
-    result0 = list(generate_rle(generate_pixels(image, stride)))
-    assert verify == result0
+    for r, packed in zip(chosen['sequences'], chosen['packed']):
+        unpacker = Rl2Unpacker(packed, chosen['n'])
+        verify = unpacker.getList()
+        assert verify == r
 
-    basename = os.path.splitext(filename)[0]
-    rleFilename = basename + '.rle'
-    rle = open(rleFilename, 'wb')
-    rle.write('%c%c%c%c' % (w, h, stride, n))
-    rle.write(result)
-    rle.close()
-    
-    print '%s: %s vs. %s' % (rleFilename, 4 + len(result), fullSize)
-    
+    return stride, chosen, candidates
 
-# Main.
-try:
-    opts, args = getopt.getopt(sys.argv[1:], 'h')
-except getopt.error, msg:
-    usage(1, msg)
+def write_rle(image, rleFilename, formats, band_rows, weight):
+    """ Encodes the image, which has already been padded to a multiple
+    of 8 pixels wide, and writes the best encoding to rleFilename. """
 
-for opt, arg in opts:
-    if opt == '-h':
-        usage(0)
+    w, h = image.size
+    stride, chosen, candidates = encode_best(image, formats, band_rows, weight)
 
-print args
-for filename in args:
-    make_rle(filename)
+    rle = open(rleFilename, 'wb')
+    rle.write(chosen['rle'])
+    rle.close()
+
+    summary = '%s: %s vs. %s (format %s, n = %s, %s decode ops)' % (
+        rleFilename, chosen['bytes'], h * stride, chosen['format'], chosen['n'], chosen['decode_ops'])
+    return (rleFilename, summary, report_entry(rleFilename, w, h, stride, chosen, candidates))
+
+def atlas_frames(spec):
+    """ Returns the frames of an atlas description, as a list of
+    (filename, flip_x). """
+
+    frames = []
+    for frame in spec['frames']:
+        if isinstance(frame, dict):
+            frames.append((frame['image'], frame.get('flip_x', False)))
+        else:
+            frames.append((frame, False))
+    return frames
+
+def atlas_images(spec):
+    """ Returns the filenames of the distinct images of an atlas
+    description. """
+
+    images = [spec['mask']]
+    for filename, flip_x in atlas_frames(spec):
+        if filename not in images:
+            images.append(filename)
+    return images
+
+def make_atlas(atlasFilename, spec, formats, band_rows, weight):
+    """ Encodes the sprite atlas described by spec (see the help), and
+    writes it to atlasFilename.  Returns a list of (atlasFilename,
+    summary, report entry) for its images, as make_rle() does. """
+
+    # The distinct images, as (filename, mirrored), in order of first
+    # use.
+    images = []
+    def image_index(filename, mirrored):
+        if (filename, mirrored) not in images:
+            images.append((filename, mirrored))
+        return images.index((filename, mirrored))
+
+    frames = atlas_frames(spec)
+    assert 0 < len(frames) <= ATLAS_MAX_FRAMES
+
+    # A mirrored copy is centered at the sprite's width less cx, the
+    # width being padded as load_image() pads it.
+    width = load_image(spec['mask']).size[0]
+    facings = [False, True] if spec.get('mirror', False) else [False]
+    table = b''
+    for mirrored in facings:
+        cx = (width - spec['cx']) if mirrored else spec['cx']
+        assert 0 <= cx <= 0xff
+        table += bytes([cx, image_index(spec['mask'], mirrored)])
+        for filename, flip_x in frames:
+            table += bytes([image_index(filename, mirrored) | (ATLAS_FLIP_X if flip_x else 0)])
+    assert len(images) <= ATLAS_MAX_IMAGES
+
+    encoded = []
+    for filename, mirrored in images:
+        image = load_image(filename)
+        if mirrored:
+            image = image.transpose(PIL.Image.FLIP_LEFT_RIGHT)
+        encoded.append(encode_best(image, formats, band_rows, weight, final = True))
+
+    offset = 4 + 2 * len(images) + len(table)
+    index = b''
+    for stride, chosen, candidates in encoded:
+        assert offset <= 0xffff
+        index += bytes([offset & 0xff, offset >> 8])
+        offset += len(chosen['rle'])
+
+    atlas = open(atlasFilename, 'wb')
+    atlas.write(bytes([len(images), len(frames), len(facings), 0]) + index + table)
+    for stride, chosen, candidates in encoded:
+        atlas.write(chosen['rle'])
+    atlas.close()
+
+    results = []
+    for i, ((filename, mirrored), (stride, chosen, candidates)) in enumerate(zip(images, encoded)):
+        name = atlas_image_name(atlasFilename, i)
+        w, h = chosen['rle'][0], chosen['rle'][1]
+        summary = '%s: %s%s, %s vs. %s (format %s, n = %s, %s decode ops)' % (
+            name, filename, ' mirrored' if mirrored else '', chosen['bytes'], h * stride,
+            chosen['format'], chosen['n'], chosen['decode_ops'])
+        results.append((atlasFilename, summary, report_entry(name, w, h, stride, chosen, candidates)))
+    return results
+
+def atlas_image_name(atlasFilename, i):
+    """ Returns the name of the indicated image of an atlas, for the
+    report. """
+
+    return '%s#%d' % (os.path.basename(atlasFilename), i)
+
+def read_rle(rleFilename):
+    """ Reads an existing .rle file, and returns its report, for -R. """
+
+    return [rle_report(rleFilename, open(rleFilename, 'rb').read())]
+
+def read_atlas(atlasFilename):
+    """ Reads an existing .atlas file, and returns the report of each
+    of its images, for -R. """
+
+    atlas = open(atlasFilename, 'rb').read()
+    num_images = atlas[0]
+    offsets = [atlas[4 + i * 2] | (atlas[5 + i * 2] << 8) for i in range(num_images)]
+    offsets.append(len(atlas))
+    return [rle_report(atlas_image_name(atlasFilename, i), atlas[offsets[i]:offsets[i + 1]])
+            for i in range(num_images)]
+
+def rle_report(name, rle):
+    """ Returns the report of the rle image in the indicated bytes. """
+
+    w, h, stride = rle[0], rle[1], rle[2]
+    format, n = rle[3] >> 4, rle[3] & 0xf
+
+    refs = []
+    if format == 1:
+        band_rows, num_bands = rle[4], rle[5]
+        data_start = 6 + num_bands * 2
+        offsets = [rle[6 + i * 2] | (rle[7 + i * 2] << 8) for i in range(num_bands)]
+        offsets.append(len(rle) - data_start)
+        runs = [Rl2Unpacker(rle[data_start + offsets[i]:data_start + offsets[i + 1]], n).getList() for i in range(num_bands)]
+    else:
+        data_start = 4
+        runs = [Rl2Unpacker(rle[data_start:], n).getList()]
+        if format == 2:
+            refs = runs[0][-h:]
+            runs[0] = runs[0][:-h]
+
+    chosen = {
+        'format' : format,
+        'n' : n,
+        'bytes' : len(rle),
+        'decode_ops' : estimate_decode_ops(runs, stride, refs, len(rle) - data_start),
+        }
+    return report_entry(name, w, h, stride, chosen, None)
+
+def file_hash(filename):
+    """ Returns the SHA-1 of the file's contents, or None if it can't
+    be read. """
+
+    try:
+        return hashlib.sha1(open(filename, 'rb').read()).hexdigest()
+    except IOError:
+        return None
+
+def image_key(filename, options, spec = None):
+    """ Returns the cache key of an image: the hash of its contents,
+    the options it is encoded with, and this script.  For an atlas,
+    filename is the atlas, and spec its description, whose images
+    count instead. """
+
+    key = hashlib.sha1()
+    if spec is None:
+        key.update(open(filename, 'rb').read())
+    else:
+        key.update(json.dumps(spec, sort_keys = True).encode())
+        for image in atlas_images(spec):
+            key.update(open(image, 'rb').read())
+    key.update(repr(options).encode())
+    key.update(open(os.path.abspath(__file__), 'rb').read())
+    return key.hexdigest()
+
+def up_to_date(entry, key):
+    """ Returns true if the cache entry for an image is for the
+    indicated key, and its .rle files are still as they were
+    written. """
+
+    if entry is None or entry['key'] != key:
+        return False
+    for rleFilename, rleHash in entry['outputs'].items():
+        if file_hash(rleFilename) != rleHash:
+            return False
+    return True
+
+def encode_image(args):
+    """ The work of one image, for the pool in main(). """
+
+    filename, spec, options = args
+    formats, band_rows, mirror, weight = options
+    if spec is not None:
+        return make_atlas(filename, spec, formats, band_rows, weight)
+    return make_rle(filename, formats, band_rows, mirror, weight)
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], 'r:xpda:w:j:c:nR:h')
+    except getopt.error as msg:
+        usage(1, msg)
+
+    band_rows = None
+    mirror = False
+    formats = [0, 2]
+    weight = DEFAULT_WEIGHT
+    jobs = multiprocessing.cpu_count()
+    cacheFilename = None
+    reportFilename = None
+    atlases = None
+    checkOnly = False
+    for opt, arg in opts:
+        if opt == '-r':
+            band_rows = int(arg)
+            if band_rows < 1 or band_rows > 0xff:
+                usage(1, 'invalid band rows: %s' % (arg))
+            formats = [1]
+        elif opt == '-x':
+            mirror = True
+        elif opt == '-p':
+            formats = [0]
+        elif opt == '-d':
+            formats = [2]
+        elif opt == '-a':
+            atlases = json.load(open(arg))
+        elif opt == '-w':
+            weight = float(arg)
+            if weight < 0:
+                usage(1, 'invalid weight: %s' % (arg))
+        elif opt == '-j':
+            jobs = int(arg)
+            if jobs < 1:
+                usage(1, 'invalid jobs: %s' % (arg))
+        elif opt == '-c':
+            cacheFilename = arg
+        elif opt == '-n':
+            checkOnly = True
+        elif opt == '-R':
+            reportFilename = arg
+        elif opt == '-h':
+            usage(0)
+
+    if len([opt for opt, arg in opts if opt in ['-r', '-p', '-d']]) > 1:
+        usage(1, '-r, -p and -d cannot be combined')
+    if checkOnly and (cacheFilename is None or reportFilename is not None):
+        usage(1, '-n needs -c, and cannot be combined with -R')
+    if not checkOnly and numpy is None:
+        print('make_rle.py needs Pillow and numpy to encode images', file = sys.stderr)
+        sys.exit(1)
+    if atlases is not None:
+        if args:
+            usage(1, 'images may not be given with -a')
+        args = sorted(atlases.keys())
+
+    options = (formats, band_rows, mirror, weight)
+
+    cache = {}
+    if cacheFilename is not None and os.path.exists(cacheFilename):
+        cache = json.load(open(cacheFilename))
+
+    # Work out which images need to be encoded.
+    reports = {}
+    work = []
+    for filename in args:
+        spec = None
+        if atlases is not None:
+            spec = atlases[filename]
+        elif filename.endswith('.rle') or filename.endswith('.atlas'):
+            if reportFilename is None:
+                usage(1, '.rle and .atlas files may only be given with -R')
+            reports[filename] = read_atlas(filename) if filename.endswith('.atlas') else read_rle(filename)
+            continue
+
+        key = image_key(filename, options, spec)
+        entry = cache.get(filename)
+        if cacheFilename is not None and up_to_date(entry, key):
+            if not checkOnly:
+                print('%s: up to date' % (filename))
+                reports[filename] = entry['report']
+        else:
+            work.append((filename, key, spec))
+
+    if checkOnly:
+        for filename, key, spec in work:
+            print('%s: out of date' % (filename), file = sys.stderr)
+        sys.exit(1 if work else 0)
+
+    # Encode them, in parallel if there's more than one.
+    if jobs > 1 and len(work) > 1:
+        pool = multiprocessing.Pool(min(jobs, len(work)))
+        results = pool.map(encode_image, [(filename, spec, options) for filename, key, spec in work])
+        pool.close()
+        pool.join()
+    else:
+        results = [encode_image((filename, spec, options)) for filename, key, spec in work]
+
+    for (filename, key, spec), written in zip(work, results):
+        for rleFilename, summary, entry in written:
+            print(summary)
+        reports[filename] = [entry for rleFilename, summary, entry in written]
+        cache[filename] = {
+            'key' : key,
+            'outputs' : dict((rleFilename, file_hash(rleFilename)) for rleFilename, summary, entry in written),
+            'report' : reports[filename],
+            }
+
+    if cacheFilename is not None:
+        out = open(cacheFilename, 'w')
+        json.dump(cache, out, indent = 2, sort_keys = True)
+        out.close()
+
+    if reportFilename is not None:
+        report = []
+        for filename in args:
+            report += reports[filename]
+        out = open(reportFilename, 'w')
+        json.dump({ 'weight' : weight, 'resources' : report }, out, indent = 2, sort_keys = True)
+        out.write('\n')
+        out.close()
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,189 @@
+#include <pebble.h>
+#include "arena.h"
+#include "assert.h"
+#include "perf_stats.h"
+
+typedef struct {
+  GBitmap *bitmap;  // Points into data; its bounds change with each use.
+  uint8_t *data;    // A BitmapDataHeader, followed by the pixels.
+  size_t size;      // Total bytes in data.
+  bool in_use;
+} ArenaSlot;
+
+static ArenaSlot arena_slots[ARENA_MAX_SLOTS];
+static int arena_num_slots = 0;
+
+// Allocates the indicated slots, each slot_sizes[i] bytes including
+// its BitmapDataHeader.  Returns false, leaving the arena empty, if
+// the heap can't hold them all; in that case arena_rle_bwd_create()
+// falls back to the heap.
+bool arena_init(const size_t *slot_sizes, int num_slots) {
+  assert(arena_num_slots == 0 && num_slots <= ARENA_MAX_SLOTS);
+  for (int i = 0; i < num_slots; ++i) {
+    ArenaSlot *slot = &arena_slots[i];
+    slot->size = slot_sizes[i];
+    slot->in_use = false;
+    slot->data = (uint8_t *)malloc(slot->size);
+    if (slot->data == NULL) {
+      arena_num_slots = i;
+      arena_deinit();
+      return false;
+    }
+    memset(slot->data, 0, sizeof(BitmapDataHeader));
+    slot->bitmap = gbitmap_create_with_data(slot->data);
+    arena_num_slots = i + 1;
+    if (slot->bitmap == NULL) {
+      arena_deinit();
+      return false;
+    }
+  }
+  return true;
+}
+
+// Adds up to num_slots more slots of slot_size bytes each, as long as
+// at least heap_reserve bytes of the heap remain free after each one.
+// Returns the number of slots added.
+int arena_add_slots(size_t slot_size, int num_slots, size_t heap_reserve) {
+  int added = 0;
+  while (added < num_slots && arena_num_slots < ARENA_MAX_SLOTS &&
+         heap_bytes_free() >= slot_size + heap_reserve) {
+    ArenaSlot *slot = &arena_slots[arena_num_slots];
+    slot->size = slot_size;
+    slot->in_use = false;
+    slot->data = (uint8_t *)malloc(slot->size);
+    if (slot->data == NULL) {
+      break;
+    }
+    memset(slot->data, 0, sizeof(BitmapDataHeader));
+    slot->bitmap = gbitmap_create_with_data(slot->data);
+    if (slot->bitmap == NULL) {
+      free(slot->data);
+      slot->data = NULL;
+      break;
+    }
+    ++arena_num_slots;
+    ++added;
+  }
+  return added;
+}
+
+void arena_deinit() {
+  for (int i = 0; i < arena_num_slots; ++i) {
+    ArenaSlot *slot = &arena_slots[i];
+    assert(!slot->in_use);
+    if (slot->bitmap != NULL) {
+      gbitmap_destroy(slot->bitmap);
+      slot->bitmap = NULL;
+    }
+    free(slot->data);
+    slot->data = NULL;
+  }
+  arena_num_slots = 0;
+}
+
+// Returns the smallest free slot that can hold size bytes, or NULL if
+// there isn't one.
+static ArenaSlot *arena_find_slot(size_t size) {
+  ArenaSlot *best = NULL;
+  for (int i = 0; i < arena_num_slots; ++i) {
+    ArenaSlot *slot = &arena_slots[i];
+    if (!slot->in_use && slot->size >= size && (best == NULL || slot->size < best->size)) {
+      best = slot;
+    }
+  }
+  return best;
+}
+
+// Returns true if a bitmap of size bytes, with its header, can be
+// decoded into the arena right now.
+bool arena_has_room(size_t size) {
+  return arena_find_slot(size) != NULL;
+}
+
+// Returns the number of free slots of exactly slot_size bytes.  Bigger
+// slots don't count: they're meant for something else, which may yet
+// want them.
+int arena_num_free(size_t slot_size) {
+  int count = 0;
+  for (int i = 0; i < arena_num_slots; ++i) {
+    ArenaSlot *slot = &arena_slots[i];
+    if (!slot->in_use && slot->size == slot_size) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+// Decodes an rle resource into a free slot of the arena, or onto the
+// heap if none of the free slots are big enough.  Either way, release
+// it with bwd_destroy().
+BitmapWithData
+arena_rle_bwd_create(int resource_id) {
+  return arena_rle_bwd_create_offset(resource_id, 0);
+}
+
+// As above, for an rle image that begins at the indicated byte offset
+// within the resource.
+BitmapWithData
+arena_rle_bwd_create_offset(int resource_id, size_t offset) {
+  PERF_BEGIN(start);
+  RleHeader header;
+  rle_header_init_offset(resource_id, offset, &header);
+
+  ArenaSlot *slot = arena_find_slot(rle_bitmap_size(&header));
+  if (slot == NULL) {
+    return rle_bwd_create_offset(resource_id, offset);
+  }
+
+  slot->in_use = true;
+  rle_decode_into(&header, slot->data);
+
+  // Re-aim the slot's GBitmap at this image rather than creating a
+  // new one.
+  GBitmap *image = slot->bitmap;
+  image->row_size_bytes = header.stride;
+  image->bounds = GRect(0, 0, header.width, header.height);
+  PERF_END(PERF_RLE_DECODE, start);
+  return bwd_create(image, slot->data);
+}
+
+// Copies the bitmap into a free slot of the arena, or onto the heap if
+// none of the free slots are big enough.  Either way, release it with
+// bwd_destroy().  Returns a NULL bitmap if there isn't enough memory.
+BitmapWithData
+arena_bwd_copy(GBitmap *source) {
+  int stride = source->row_size_bytes;
+  int width = source->bounds.size.w;
+  int height = source->bounds.size.h;
+  ArenaSlot *slot = arena_find_slot(sizeof(BitmapDataHeader) + stride * height);
+  if (slot == NULL) {
+    return bwd_copy(source);
+  }
+
+  slot->in_use = true;
+  memcpy(slot->data + sizeof(BitmapDataHeader), source->addr, stride * height);
+
+  GBitmap *image = slot->bitmap;
+  image->row_size_bytes = stride;
+  image->bounds = GRect(0, 0, width, height);
+  return bwd_create(image, slot->data);
+}
+
+// If bwd came from the arena, returns its slot to the arena, clears
+// bwd, and returns true.  Otherwise returns false.
+bool arena_release(BitmapWithData *bwd) {
+  if (bwd->data == NULL) {
+    return false;
+  }
+  for (int i = 0; i < arena_num_slots; ++i) {
+    ArenaSlot *slot = &arena_slots[i];
+    if (slot->data == bwd->data) {
+      assert(slot->in_use && bwd->bitmap == slot->bitmap);
+      slot->in_use = false;
+      bwd->bitmap = NULL;
+      bwd->data = NULL;
+      return true;
+    }
+  }
+  return false;
+}
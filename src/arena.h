@@ -0,0 +1,28 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <pebble.h>
+#include "bwd.h"
+
+// A handful of fixed slots for the big bitmaps that come and go with
+// every transition: the faces, the sprite and its mask.  The slots
+// are allocated once, at arena_init(), and bitmaps are decoded into
+// whichever one is free, so that the steady state does no heap
+// allocation (and can't fragment the heap).  Bitmaps from the arena
+// are released with bwd_destroy(), like any other.  More slots, for
+// bitmaps that are nice to have but not essential, can be added with
+// arena_add_slots() while the heap allows.
+
+#define ARENA_MAX_SLOTS 12
+
+bool arena_init(const size_t *slot_sizes, int num_slots);
+int arena_add_slots(size_t slot_size, int num_slots, size_t heap_reserve);
+void arena_deinit();
+bool arena_has_room(size_t size);
+int arena_num_free(size_t slot_size);
+BitmapWithData arena_rle_bwd_create(int resource_id);
+BitmapWithData arena_rle_bwd_create_offset(int resource_id, size_t offset);
+BitmapWithData arena_bwd_copy(GBitmap *source);
+bool arena_release(BitmapWithData *bwd);
+
+#endif  // ARENA_H
@@ -57,9 +57,11 @@ void battery_gauge_layer_update_callback(Layer *me, GContext *ctx) {
   }
 }
 
-// Update the battery guage.
+// Update the battery guage, and let the rest of the face know if it
+// should save power.
 void handle_battery(BatteryChargeState charge_state) {
   layer_mark_dirty(battery_gauge_layer);
+  apply_power_mode();
 }
 
 void init_battery_gauge(Layer *window_layer, int x, int y, bool on_black, bool opaque_layer) {
@@ -83,3 +85,17 @@ void deinit_battery_gauge() {
 void refresh_battery_gauge() {
   layer_mark_dirty(battery_gauge_layer);
 }
+
+// Returns true if the face should save power: that is, if we're
+// running on a battery that has fallen to the configured low_power
+// level.
+bool battery_low_power() {
+  if (config.low_power == 0) {
+    return false;
+  }
+  BatteryChargeState charge_state = battery_state_service_peek();
+  if (charge_state.is_charging || charge_state.is_plugged) {
+    return false;
+  }
+  return charge_state.charge_percent <= config.low_power;
+}
@@ -7,5 +7,8 @@
 void init_battery_gauge(Layer *window_layer, int x, int y, bool on_black, bool opaque_layer);
 void deinit_battery_gauge();
 void refresh_battery_gauge();
+bool battery_low_power();
+
+void apply_power_mode();  // implemented in the main program
 
 #endif  // BATTERY_GAUGE_H
@@ -0,0 +1,191 @@
+#include <pebble.h>
+#include "bitmap_transform.h"
+#include "assert.h"
+
+// Pixel x of a row is bit (x % 8) of byte (x / 8), so on the
+// (little-endian) Pebble it is also bit (x % 32) of word (x / 32).
+// Moving pixels toward x = 0 is therefore a right shift of the word.
+
+// reverse_table[b] is b with its bits in the opposite order.
+static const uint8_t reverse_table[256] = {
+  0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
+  0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
+  0x08, 0x88, 0x48, 0xc8, 0x28, 0xa8, 0x68, 0xe8,
+  0x18, 0x98, 0x58, 0xd8, 0x38, 0xb8, 0x78, 0xf8,
+  0x04, 0x84, 0x44, 0xc4, 0x24, 0xa4, 0x64, 0xe4,
+  0x14, 0x94, 0x54, 0xd4, 0x34, 0xb4, 0x74, 0xf4,
+  0x0c, 0x8c, 0x4c, 0xcc, 0x2c, 0xac, 0x6c, 0xec,
+  0x1c, 0x9c, 0x5c, 0xdc, 0x3c, 0xbc, 0x7c, 0xfc,
+  0x02, 0x82, 0x42, 0xc2, 0x22, 0xa2, 0x62, 0xe2,
+  0x12, 0x92, 0x52, 0xd2, 0x32, 0xb2, 0x72, 0xf2,
+  0x0a, 0x8a, 0x4a, 0xca, 0x2a, 0xaa, 0x6a, 0xea,
+  0x1a, 0x9a, 0x5a, 0xda, 0x3a, 0xba, 0x7a, 0xfa,
+  0x06, 0x86, 0x46, 0xc6, 0x26, 0xa6, 0x66, 0xe6,
+  0x16, 0x96, 0x56, 0xd6, 0x36, 0xb6, 0x76, 0xf6,
+  0x0e, 0x8e, 0x4e, 0xce, 0x2e, 0xae, 0x6e, 0xee,
+  0x1e, 0x9e, 0x5e, 0xde, 0x3e, 0xbe, 0x7e, 0xfe,
+  0x01, 0x81, 0x41, 0xc1, 0x21, 0xa1, 0x61, 0xe1,
+  0x11, 0x91, 0x51, 0xd1, 0x31, 0xb1, 0x71, 0xf1,
+  0x09, 0x89, 0x49, 0xc9, 0x29, 0xa9, 0x69, 0xe9,
+  0x19, 0x99, 0x59, 0xd9, 0x39, 0xb9, 0x79, 0xf9,
+  0x05, 0x85, 0x45, 0xc5, 0x25, 0xa5, 0x65, 0xe5,
+  0x15, 0x95, 0x55, 0xd5, 0x35, 0xb5, 0x75, 0xf5,
+  0x0d, 0x8d, 0x4d, 0xcd, 0x2d, 0xad, 0x6d, 0xed,
+  0x1d, 0x9d, 0x5d, 0xdd, 0x3d, 0xbd, 0x7d, 0xfd,
+  0x03, 0x83, 0x43, 0xc3, 0x23, 0xa3, 0x63, 0xe3,
+  0x13, 0x93, 0x53, 0xd3, 0x33, 0xb3, 0x73, 0xf3,
+  0x0b, 0x8b, 0x4b, 0xcb, 0x2b, 0xab, 0x6b, 0xeb,
+  0x1b, 0x9b, 0x5b, 0xdb, 0x3b, 0xbb, 0x7b, 0xfb,
+  0x07, 0x87, 0x47, 0xc7, 0x27, 0xa7, 0x67, 0xe7,
+  0x17, 0x97, 0x57, 0xd7, 0x37, 0xb7, 0x77, 0xf7,
+  0x0f, 0x8f, 0x4f, 0xcf, 0x2f, 0xaf, 0x6f, 0xef,
+  0x1f, 0x9f, 0x5f, 0xdf, 0x3f, 0xbf, 0x7f, 0xff,
+};
+
+// Reverse the bits of a byte.
+uint8_t reverse_bits(uint8_t b) {
+  return reverse_table[b];
+}
+
+// Reverse the bits of a word.
+static inline uint32_t reverse_word(uint32_t w) {
+  return (((uint32_t)reverse_table[w & 0xff] << 24) |
+          ((uint32_t)reverse_table[(w >> 8) & 0xff] << 16) |
+          ((uint32_t)reverse_table[(w >> 16) & 0xff] << 8) |
+          (uint32_t)reverse_table[w >> 24]);
+}
+
+// Returns the mask of the bits of a row's last word that fall within
+// the indicated width.
+static inline uint32_t last_word_mask(int width) {
+  int b = width & 31;
+  return (b == 0) ? ~0U : ((1U << b) - 1);
+}
+
+// Copies dest_words words' worth of pixels from src, beginning at
+// pixel src_x, into dest.  Pixels beyond the end of src read as
+// black.  dest may be the same row as src, as long as src_x >= 0.
+static void copy_row_bits(uint32_t *dest, int dest_words, const uint32_t *src, int src_words, int src_x) {
+  int sw = src_x >> 5;
+  int sb = src_x & 31;
+  for (int i = 0; i < dest_words; ++i, ++sw) {
+    uint32_t lo = (sw < src_words) ? src[sw] : 0;
+    if (sb == 0) {
+      dest[i] = lo;
+    } else {
+      uint32_t hi = (sw + 1 < src_words) ? src[sw + 1] : 0;
+      dest[i] = (lo >> sb) | (hi << (32 - sb));
+    }
+  }
+}
+
+// Shifts a row of pixels away from x = 0 by dx pixels, in-place.
+// The vacated pixels become black.
+static void shift_row_right(uint32_t *row, int num_words, int dx) {
+  int dw = dx >> 5;
+  int db = dx & 31;
+  for (int i = num_words - 1; i >= 0; --i) {
+    int sw = i - dw;
+    uint32_t hi = (sw >= 0) ? row[sw] : 0;
+    if (db == 0) {
+      row[i] = hi;
+    } else {
+      uint32_t lo = (sw - 1 >= 0) ? row[sw - 1] : 0;
+      row[i] = (hi << db) | (lo >> (32 - db));
+    }
+  }
+}
+
+// Horizontally flips the indicated GBitmap in-place.  Each row is
+// reversed a whole word at a time, which leaves the image hard
+// against the right end of the row (the padding bits having moved to
+// the left); then it is shifted back into place.
+void bitmap_flip_x(GBitmap *image) {
+  int height = image->bounds.size.h;
+  int width = image->bounds.size.w;
+  int stride = image->row_size_bytes;  // multiple of 4, by Pebble.
+  int num_words = stride / 4;
+  int pad = num_words * 32 - width;
+  uint8_t *data = image->addr;
+
+  for (int y = 0; y < height; ++y) {
+    uint32_t *row = (uint32_t *)(data + y * stride);
+    int i = 0;
+    int j = num_words - 1;
+    for (; i < j; ++i, --j) {
+      uint32_t w = reverse_word(row[i]);
+      row[i] = reverse_word(row[j]);
+      row[j] = w;
+    }
+    if (i == j) {
+      row[i] = reverse_word(row[i]);
+    }
+    if (pad != 0) {
+      copy_row_bits(row, num_words, row, num_words, pad);
+    }
+  }
+}
+
+// Shifts the indicated GBitmap horizontally in-place, by dx pixels:
+// to the right if dx is positive, or to the left if it is negative.
+// Pixels shifted past the edge are lost, and the columns vacated
+// become black.
+void bitmap_shift_x(GBitmap *image, int dx) {
+  int height = image->bounds.size.h;
+  int width = image->bounds.size.w;
+  int stride = image->row_size_bytes;
+  int num_words = stride / 4;
+  uint32_t mask = last_word_mask(width);
+  uint8_t *data = image->addr;
+
+  if (dx >= width || -dx >= width) {
+    memset(data, 0, stride * height);
+    return;
+  }
+
+  for (int y = 0; y < height; ++y) {
+    uint32_t *row = (uint32_t *)(data + y * stride);
+    if (dx > 0) {
+      shift_row_right(row, num_words, dx);
+      // Clear whatever was pushed out into the row's padding.
+      int last = (width - 1) >> 5;
+      row[last] &= mask;
+      for (int i = last + 1; i < num_words; ++i) {
+        row[i] = 0;
+      }
+    } else if (dx < 0) {
+      copy_row_bits(row, num_words, row, num_words, -dx);
+    }
+  }
+}
+
+// Returns a new bitmap holding a copy of the indicated rectangle of
+// the source bitmap.  The rectangle must lie within the source.  The
+// returned bitmap must be released with bwd_destroy(); it is NULL if
+// there isn't enough memory.
+BitmapWithData bwd_crop(GBitmap *source, GRect rect) {
+  assert(rect.origin.x >= 0 && rect.origin.y >= 0 &&
+         rect.origin.x + rect.size.w <= source->bounds.size.w &&
+         rect.origin.y + rect.size.h <= source->bounds.size.h);
+
+  BitmapWithData bwd = bwd_create_empty(rect.size.w, rect.size.h);
+  if (bwd.bitmap == NULL) {
+    return bwd;
+  }
+
+  int src_stride = source->row_size_bytes;
+  int src_words = src_stride / 4;
+  int dest_stride = bwd.bitmap->row_size_bytes;
+  int dest_words = dest_stride / 4;
+  uint32_t mask = last_word_mask(rect.size.w);
+  uint8_t *src_data = (uint8_t *)source->addr + rect.origin.y * src_stride;
+  uint8_t *dest_data = bwd.bitmap->addr;
+
+  for (int y = 0; y < rect.size.h; ++y) {
+    uint32_t *dest = (uint32_t *)(dest_data + y * dest_stride);
+    copy_row_bits(dest, dest_words, (uint32_t *)(src_data + y * src_stride), src_words, rect.origin.x);
+    dest[dest_words - 1] &= mask;
+  }
+
+  return bwd;
+}
@@ -0,0 +1,16 @@
+#ifndef BITMAP_TRANSFORM_H
+#define BITMAP_TRANSFORM_H
+
+#include <pebble.h>
+#include "bwd.h"
+
+// Transformations on 1-bpp bitmaps, of any width.  These all work a
+// 32-bit word at a time, and so rely on each row being word-aligned,
+// as Pebble bitmaps always are.
+
+uint8_t reverse_bits(uint8_t b);
+void bitmap_flip_x(GBitmap *image);
+void bitmap_shift_x(GBitmap *image, int dx);
+BitmapWithData bwd_crop(GBitmap *source, GRect rect);
+
+#endif  // BITMAP_TRANSFORM_H
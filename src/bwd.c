@@ -0,0 +1,645 @@
+#include <pebble.h>
+#include "bwd.h"
+#include "assert.h"
+#include "perf_stats.h"
+#include "arena.h"
+
+// The buffer for the common case of just one RBuffer open at a time,
+// so that reading a resource needn't touch the heap.
+static uint8_t rbuffer_static_buffer[RBUFFER_SIZE];
+static bool rbuffer_static_in_use = false;
+
+// Begins reading from a raw resource.  Should be matched by a later
+// call to rbuffer_deinit() to free this stuff.
+void rbuffer_init(int resource_id, RBuffer *rb) {
+  rbuffer_init_offset(resource_id, rb, 0);
+}
+
+// As above, but begins reading at the indicated byte offset within
+// the resource.
+void rbuffer_init_offset(int resource_id, RBuffer *rb, size_t offset) {
+  if (!rbuffer_static_in_use) {
+    rbuffer_static_in_use = true;
+    rb->_buffer = rbuffer_static_buffer;
+  } else {
+    rb->_buffer = (uint8_t *)malloc(RBUFFER_SIZE);
+  }
+  assert(rb->_buffer != NULL);
+  
+  rb->_rh = resource_get_handle(resource_id);
+  rbuffer_seek(rb, offset);
+}
+
+// Begins reading from size bytes of data already in RAM, rather than
+// from a resource.  The data is borrowed, not copied, and must outlive
+// the rbuffer.
+void rbuffer_init_data(RBuffer *rb, const uint8_t *data, size_t size) {
+  rb->_rh = NULL;
+  rb->_buffer = (uint8_t *)data;
+  rb->_i = 0;
+  rb->_filled_size = size;
+  rb->_bytes_read = size;
+}
+
+// Repositions the rbuffer to continue reading from the indicated
+// byte offset within the resource.
+void rbuffer_seek(RBuffer *rb, size_t offset) {
+  rb->_i = 0;
+  rb->_filled_size = resource_load_byte_range(rb->_rh, offset, rb->_buffer, RBUFFER_SIZE);
+  rb->_bytes_read = offset + rb->_filled_size;
+}
+
+// Loads the next block of the resource, once the current one has
+// been entirely consumed.  Returns the number of bytes now available
+// in the buffer, or 0 at the end of the resource.
+size_t rbuffer_refill(RBuffer *rb) {
+  if (rb->_rh != NULL && rb->_i >= RBUFFER_SIZE) {
+    rb->_filled_size = resource_load_byte_range(rb->_rh, rb->_bytes_read, rb->_buffer, RBUFFER_SIZE);
+    rb->_bytes_read += rb->_filled_size;
+    rb->_i = 0;
+  }
+  if (rb->_i >= rb->_filled_size) {
+    return 0;
+  }
+  return rb->_filled_size - rb->_i;
+}
+
+// Gets the next byte from the rbuffer.  Returns EOF at end.
+int rbuffer_getc(RBuffer *rb) {
+  if (rb->_i >= rb->_filled_size && rbuffer_refill(rb) == 0) {
+    return EOF;
+  }
+
+  int result = rb->_buffer[rb->_i];
+  rb->_i++;
+  return result;
+}
+
+// Frees the resources reserved in rbuffer_init().
+void rbuffer_deinit(RBuffer *rb) {
+  assert(rb->_buffer != NULL);
+  if (rb->_rh == NULL) {
+    // Borrowed by rbuffer_init_data().
+  } else if (rb->_buffer == rbuffer_static_buffer) {
+    rbuffer_static_in_use = false;
+  } else {
+    free(rb->_buffer);
+  }
+  rb->_buffer = NULL;
+}
+
+BitmapWithData bwd_create(GBitmap *bitmap, void *data) {
+  BitmapWithData bwd;
+  bwd.bitmap = bitmap;
+  bwd.data = data;
+  return bwd;
+}
+
+// Allocates a new, all-black bitmap of the indicated size.  The
+// returned bitmap must be released with bwd_destroy().  Returns a
+// NULL bitmap if there isn't enough memory.
+BitmapWithData bwd_create_empty(int width, int height) {
+  // The number of bytes in a row.  Must be a multiple of 4, per
+  // Pebble conventions.
+  int stride = ((width + 31) / 32) * 4;
+  size_t data_size = height * stride;
+  size_t total_size = sizeof(BitmapDataHeader) + data_size;
+  uint8_t *bitmap = (uint8_t *)malloc(total_size);
+  if (bitmap == NULL) {
+    return bwd_create(NULL, NULL);
+  }
+  memset(bitmap, 0, total_size);
+  BitmapDataHeader *bitmap_header = (BitmapDataHeader *)bitmap;
+  bitmap_header->row_size_bytes = stride;
+  bitmap_header->size_w = width;
+  bitmap_header->size_h = height;
+
+  GBitmap *image = gbitmap_create_with_data(bitmap);
+  if (image == NULL) {
+    free(bitmap);
+    return bwd_create(NULL, NULL);
+  }
+  return bwd_create(image, bitmap);
+}
+
+// Allocates a new bitmap the same size as the indicated GBitmap, and
+// copies its pixels.  The returned bitmap must be released with
+// bwd_destroy().  Returns a NULL bitmap if there isn't enough memory.
+BitmapWithData bwd_copy(GBitmap *source) {
+  BitmapWithData bwd = bwd_create_empty(source->bounds.size.w, source->bounds.size.h);
+  if (bwd.bitmap != NULL) {
+    assert(bwd.bitmap->row_size_bytes == source->row_size_bytes);
+    memcpy(bwd.bitmap->addr, source->addr, source->row_size_bytes * source->bounds.size.h);
+  }
+  return bwd;
+}
+
+void bwd_destroy(BitmapWithData *bwd) {
+  if (arena_release(bwd)) {
+    return;
+  }
+  if (bwd->bitmap != NULL) {
+    gbitmap_destroy(bwd->bitmap);
+    bwd->bitmap = NULL;
+  }
+  if (bwd->data != NULL) {
+    free(bwd->data);
+    bwd->data = NULL;
+  }
+}
+
+void rl2unpacker_init(Rl2Unpacker *rl2, RBuffer *rb, int n) {
+  // assumption: n is an integer divisor of 8.
+  assert(n * (8 / n) == 8);
+
+  rl2->rb = rb;
+  rl2->n = n;
+  rl2->n_shift = (n == 1) ? 0 : (n == 2) ? 1 : (n == 4) ? 2 : 3;
+  rl2->bits = 0;
+  rl2->num_bits = 0;
+}
+
+// Tops up the bit reservoir from the rbuffer, until it holds more
+// than 24 bits or the input is exhausted.  Whole bytes are shifted in
+// below the bits already there; the reservoir's unused low bits are
+// always zero.
+static void rl2unpacker_refill(Rl2Unpacker *rl2) {
+  RBuffer *rb = rl2->rb;
+  while (rl2->num_bits <= 24) {
+    size_t avail = rb->_filled_size - rb->_i;
+    if (rb->_i >= rb->_filled_size) {
+      avail = rbuffer_refill(rb);
+      if (avail == 0) {
+        return;
+      }
+    }
+
+    if (avail >= 4) {
+      // Pull a whole big-endian word from the buffer, and keep as
+      // many of its bytes as will fit.
+      const uint8_t *p = rb->_buffer + rb->_i;
+      uint32_t word = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+      int num_bytes = (32 - rl2->num_bits) >> 3;
+      int num_bits = rl2->num_bits + num_bytes * 8;
+      rl2->bits |= (word >> rl2->num_bits) & (~0U << (32 - num_bits));
+      rl2->num_bits = num_bits;
+      rb->_i += num_bytes;
+    } else {
+      rl2->bits |= (uint32_t)rb->_buffer[rb->_i] << (24 - rl2->num_bits);
+      rl2->num_bits += 8;
+      rb->_i++;
+    }
+  }
+}
+
+// Gets the next integer from the rl2 encoding.  Returns EOF at end.
+int rl2unpacker_getc(Rl2Unpacker *rl2) {
+  if (rl2->num_bits <= 24) {
+    rl2unpacker_refill(rl2);
+  }
+
+  // The encoder never writes a value whose run of leading zero
+  // chunks is longer than 24 bits (run lengths fit in 16 bits), so
+  // if the reservoir is all zero here, all that's left is padding.
+  if (rl2->bits == 0) {
+    return EOF;
+  }
+
+  // First, count the number of zero chunks until we come to a
+  // nonzero chunk, and discard them.
+  int zero_count = __builtin_clz(rl2->bits) >> rl2->n_shift;
+  int zero_bits = zero_count * rl2->n;
+  rl2->bits <<= zero_bits;
+  rl2->num_bits -= zero_bits;
+
+  // Infer from that the number of chunks, and hence the number of
+  // bits, that make up the value we will extract.
+  int num_chunks = (zero_count + 1);
+  int bit_count = num_chunks * rl2->n;
+  if (bit_count > rl2->num_bits) {
+    rl2unpacker_refill(rl2);
+  }
+
+  // The value is now at the top of the reservoir.
+  int result = rl2->bits >> (32 - bit_count);
+  rl2->bits <<= bit_count;
+  rl2->num_bits -= bit_count;
+  if (rl2->num_bits < 0) {
+    // The input was truncated partway through this value.
+    rl2->num_bits = 0;
+  }
+
+  return result;
+}
+
+// Sets count consecutive bits, beginning at bit pos, in a
+// word-aligned 1-bpp bitmap.  Pixel x of the image is bit (x % 8) of
+// byte (x / 8), so on the (little-endian) Pebble it is also bit
+// (x % 32) of word (x / 32); this lets us fill a long run a whole
+// word at a time, with a mask needed only at the two ends.
+static void fill_span(uint32_t *words, size_t pos, unsigned int count) {
+  uint32_t *wp = words + (pos >> 5);
+  unsigned int b0 = pos & 31;
+  unsigned int b1 = b0 + count;
+
+  if (b1 < 32) {
+    // We're still within the same word.
+    *wp |= ((1U << count) - 1) << b0;
+    return;
+  }
+
+  // We've crossed over a word boundary.
+  *wp++ |= ~0U << b0;
+  b1 -= 32;
+  while (b1 >= 32) {
+    *wp++ = ~0U;
+    b1 -= 32;
+  }
+  if (b1 != 0) {
+    *wp |= (1U << b1) - 1;
+  }
+}
+
+// Reads the header of an rle-encoded resource.  See make_rle.py for
+// the layout.
+void rle_header_init(int resource_id, RleHeader *header) {
+  rle_header_init_offset(resource_id, 0, header);
+}
+
+// As above, for an rle image that begins at the indicated byte offset
+// within the resource, as in an atlas.
+void rle_header_init_offset(int resource_id, size_t offset, RleHeader *header) {
+  uint8_t buffer[6];
+  header->resource_id = resource_id;
+  header->rh = resource_get_handle(resource_id);
+  size_t size = resource_load_byte_range(header->rh, offset, buffer, 6);
+  assert(size >= 4);
+
+  header->width = buffer[0];
+  header->height = buffer[1];
+  header->stride = buffer[2];
+  header->n = buffer[3] & 0x0f;
+  header->format = buffer[3] >> 4;
+
+  switch (header->format) {
+  case RLE_FORMAT_PLAIN:
+  case RLE_FORMAT_ROWS:
+    header->band_rows = header->height;
+    header->num_bands = 1;
+    header->data_start = offset + 4;
+    break;
+
+  case RLE_FORMAT_BANDS:
+    assert(size == 6);
+    header->band_rows = buffer[4];
+    header->num_bands = buffer[5];
+    header->data_start = offset + 6 + header->num_bands * 2;
+    break;
+
+  default:
+    assert(false);
+  }
+}
+
+// Begins decoding a run sequence from the rbuffer, with chunks of n
+// bits.
+static void rle_runs_init(RleRuns *runs, RBuffer *rb, int n) {
+  rl2unpacker_init(&runs->rl2, rb, n);
+
+  // The initial value is 0.
+  runs->value = 0;
+  runs->count = rl2unpacker_getc(&runs->rl2);
+  assert(runs->count > 0);
+  // We discard the first, implicit black pixel; it's not part of the image.
+  --runs->count;
+}
+
+// Decodes the next num_bits pixels of the run sequence into words,
+// which must start out cleared, or merely skips over them if words is
+// NULL.  We track our position as a bit offset from the start of the
+// words, since the runs flow from one row into the next (including
+// the padding bits).  A run that continues past num_bits is left
+// partly decoded, for the next call to pick up; but the value after a
+// run that ends exactly at num_bits isn't read until it is needed,
+// since it may not be a run at all.
+static void rle_runs_decode(RleRuns *runs, uint32_t *words, size_t num_bits) {
+  size_t pos = 0;
+  int count = runs->count;
+  while (count != EOF) {
+    if (pos + count >= num_bits) {
+      // The end of the stretch, partway through this run or at its
+      // very end.
+      unsigned int part = num_bits - pos;
+      if (runs->value && words != NULL) {
+        fill_span(words, pos, part);
+      }
+      count -= part;
+      break;
+    }
+
+    if (runs->value && words != NULL) {
+      // Generate count 1-bits.
+      fill_span(words, pos, count);
+    }
+    // A run of 0-bits is simply skipped over, since the words start
+    // out cleared.
+    pos += count;
+    runs->value = 1 - runs->value;
+    count = rl2unpacker_getc(&runs->rl2);
+  }
+  runs->count = count;
+}
+
+// Undoes the row delta of a row of a row-delta resource: XORs the row
+// with the row it refers to, if any, which must already be finished.
+// ref is the row's reference, as written by make_rle.py.  Working from
+// the top down, each reference row is final by the time a later row
+// needs it.
+static inline void rle_undo_row_delta(uint32_t *row, int ref, int stride_words) {
+  if (ref > 1) {
+    const uint32_t *ref_row = row - (ref - 1) * stride_words;
+    for (int i = 0; i < stride_words; ++i) {
+      row[i] ^= ref_row[i];
+    }
+  }
+}
+
+// Reads the reference of row y of a row-delta resource, once its runs
+// have been decoded; the references follow the runs.
+static inline int rle_read_row_ref(RleRuns *runs, int y) {
+  int ref = rl2unpacker_getc(&runs->rl2);
+  assert(ref >= 1 && ref <= y + 1 && ref <= RLE_STREAM_HISTORY_ROWS + 1);
+  return ref;
+}
+
+// Decodes the indicated band of rows, using the already-initialized
+// rbuffer.  band_data points to the first row of the band.
+static void rle_decode_band_rb(RleHeader *header, RBuffer *rb, int band, uint8_t *band_data) {
+  int y0 = band * header->band_rows;
+  int num_rows = header->height - y0;
+  if (num_rows > header->band_rows) {
+    num_rows = header->band_rows;
+  }
+  size_t data_size = num_rows * header->stride;
+  memset(band_data, 0, data_size);
+
+  if (header->format == RLE_FORMAT_BANDS) {
+    uint8_t offset[2];
+    resource_load_byte_range(header->rh, header->data_start - (header->num_bands - band) * 2, offset, 2);
+    rbuffer_seek(rb, header->data_start + (offset[0] | (offset[1] << 8)));
+  }
+
+  // A plain (single-band) resource omits its final run and simply
+  // ends (except within an atlas, where it runs right up to the next
+  // image), but each band of a row-indexed resource runs right up to
+  // the start of the next, and a row-delta resource's runs run right
+  // up to its row references.
+  RleRuns runs;
+  rle_runs_init(&runs, rb, header->n);
+  rle_runs_decode(&runs, (uint32_t *)band_data, data_size * 8);
+
+  if (header->format == RLE_FORMAT_ROWS) {
+    int stride_words = header->stride / 4;
+    uint32_t *row = (uint32_t *)band_data;
+    for (int y = 0; y < num_rows; ++y) {
+      rle_undo_row_delta(row, rle_read_row_ref(&runs, y), stride_words);
+      row += stride_words;
+    }
+  }
+}
+
+// Decodes just the indicated band of rows of an rle-encoded resource,
+// independently of the rest of the image.  band_data points to the
+// first row of the band (band * header->band_rows) within a bitmap of
+// header->stride bytes per row; it is completely overwritten.  Only a
+// row-indexed resource has more than one band.
+void rle_decode_band(RleHeader *header, int band, uint8_t *band_data) {
+  assert(band >= 0 && band < header->num_bands);
+  RBuffer rb;
+  rbuffer_init_offset(header->resource_id, &rb, header->data_start);
+  rle_decode_band_rb(header, &rb, band, band_data);
+  rbuffer_deinit(&rb);
+}
+
+// Returns the number of bytes needed to hold the decoded bitmap,
+// including its BitmapDataHeader.
+size_t rle_bitmap_size(RleHeader *header) {
+  return sizeof(BitmapDataHeader) + header->height * header->stride;
+}
+
+// Decodes the whole rle resource into bitmap, which must have room
+// for rle_bitmap_size() bytes: a BitmapDataHeader, followed by the
+// rows of pixels.
+void rle_decode_into(RleHeader *header, uint8_t *bitmap) {
+  BitmapDataHeader *bitmap_header = (BitmapDataHeader *)bitmap;
+  memset(bitmap_header, 0, sizeof(BitmapDataHeader));
+  uint8_t *bitmap_data = bitmap + sizeof(BitmapDataHeader);
+  bitmap_header->row_size_bytes = header->stride;
+  bitmap_header->size_w = header->width;
+  bitmap_header->size_h = header->height;
+
+  RBuffer rb;
+  rbuffer_init_offset(header->resource_id, &rb, header->data_start);
+  for (int band = 0; band < header->num_bands; ++band) {
+    rle_decode_band_rb(header, &rb, band, bitmap_data + band * header->band_rows * header->stride);
+  }
+  rbuffer_deinit(&rb);
+}
+
+// Initialize a bitmap from an rle-encoded resource.  The returned
+// bitmap must be released with bwd_destroy().  Returns a NULL bitmap
+// if there isn't enough memory.  See make_rle.py for the program that
+// generates these rle sequences.
+BitmapWithData
+rle_bwd_create(int resource_id) {
+  return rle_bwd_create_offset(resource_id, 0);
+}
+
+// As above, for an rle image that begins at the indicated byte offset
+// within the resource.
+BitmapWithData
+rle_bwd_create_offset(int resource_id, size_t offset) {
+  PERF_BEGIN(start);
+  RleHeader header;
+  rle_header_init_offset(resource_id, offset, &header);
+
+  uint8_t *bitmap = (uint8_t *)malloc(rle_bitmap_size(&header));
+  if (bitmap == NULL) {
+    return bwd_create(NULL, NULL);
+  }
+  rle_decode_into(&header, bitmap);
+
+  GBitmap *image = gbitmap_create_with_data(bitmap);
+  if (image == NULL) {
+    free(bitmap);
+    return bwd_create(NULL, NULL);
+  }
+  PERF_END(PERF_RLE_DECODE, start);
+  return bwd_create(image, bitmap);
+}
+
+// Allocates a strip for rle_stream_next_band(), big enough for images
+// of up to max_stride bytes per row.  Returns false if there isn't
+// enough memory.  Release it with rle_strip_deinit().
+bool rle_strip_init(RleStrip *strip, int max_stride) {
+  size_t size = sizeof(BitmapDataHeader) + (RLE_STREAM_HISTORY_ROWS + RLE_STREAM_BAND_ROWS) * max_stride;
+  strip->max_stride = max_stride;
+  strip->y0 = 0;
+  strip->data = (uint8_t *)malloc(size);
+  if (strip->data == NULL) {
+    strip->bitmap = NULL;
+    return false;
+  }
+  memset(strip->data, 0, size);
+  strip->bitmap = gbitmap_create_with_data(strip->data);
+  if (strip->bitmap == NULL) {
+    free(strip->data);
+    strip->data = NULL;
+    return false;
+  }
+  return true;
+}
+
+void rle_strip_deinit(RleStrip *strip) {
+  if (strip->bitmap != NULL) {
+    gbitmap_destroy(strip->bitmap);
+    strip->bitmap = NULL;
+  }
+  if (strip->data != NULL) {
+    free(strip->data);
+    strip->data = NULL;
+  }
+}
+
+// Starts decoding the run sequence at the indicated offset of the
+// stream's resource.
+static void rle_stream_start_runs(RleStream *stream, size_t offset) {
+  rbuffer_init_data(&stream->rb, stream->rle + offset, stream->rle_size - offset);
+  rle_runs_init(&stream->runs, &stream->rb, stream->header.n);
+}
+
+// Reads the whole of an rle resource into RAM, still compressed, to be
+// decoded a band at a time by rle_stream_begin() and
+// rle_stream_next_band().  Returns false, leaving the stream closed,
+// if there isn't enough memory.  Release it with rle_stream_close().
+bool rle_stream_open(RleStream *stream, int resource_id) {
+  PERF_BEGIN(start);
+  RleHeader *header = &stream->header;
+  rle_header_init(resource_id, header);
+  stream->strip = NULL;
+  stream->next_row = 0;
+  stream->refs = NULL;
+  stream->rle_size = resource_size(header->rh);
+
+  size_t refs_size = (header->format == RLE_FORMAT_ROWS) ? header->height : 0;
+  stream->rle = (uint8_t *)malloc(stream->rle_size + refs_size);
+  if (stream->rle == NULL) {
+    return false;
+  }
+  resource_load_byte_range(header->rh, 0, stream->rle, stream->rle_size);
+
+  if (header->format == RLE_FORMAT_ROWS) {
+    // The row references follow all of the runs, but each is needed
+    // as soon as its row is decoded; so we skip over the runs once
+    // now, and keep the references alongside the resource.
+    stream->refs = stream->rle + stream->rle_size;
+    rle_stream_start_runs(stream, header->data_start);
+    rle_runs_decode(&stream->runs, NULL, header->height * header->stride * 8);
+    for (int y = 0; y < header->height; ++y) {
+      stream->refs[y] = rle_read_row_ref(&stream->runs, y);
+    }
+  }
+  PERF_END(PERF_RLE_DECODE, start);
+  return true;
+}
+
+void rle_stream_close(RleStream *stream) {
+  if (stream->rle != NULL) {
+    free(stream->rle);
+    stream->rle = NULL;
+  }
+  stream->refs = NULL;
+  stream->strip = NULL;
+}
+
+// Begins a pass over the image from the top, decoding into the
+// indicated strip, which must not be used by another pass until this
+// one is finished (or abandoned; a pass need not run to the end).
+void rle_stream_begin(RleStream *stream, RleStrip *strip) {
+  assert(stream->rle != NULL && stream->header.stride <= strip->max_stride);
+  stream->strip = strip;
+  stream->next_row = 0;
+  if (stream->header.format != RLE_FORMAT_BANDS) {
+    // A row-indexed resource starts its runs afresh with each band;
+    // see rle_stream_next_band().
+    rle_stream_start_runs(stream, stream->header.data_start);
+  }
+}
+
+// Decodes the next band of rows of the pass begun by
+// rle_stream_begin() into its strip, and returns the strip's bitmap,
+// which holds just this band: RLE_STREAM_BAND_ROWS rows (fewer at the
+// bottom), beginning with image row strip->y0.  Returns NULL at the
+// end of the image.
+GBitmap *rle_stream_next_band(RleStream *stream) {
+  RleHeader *header = &stream->header;
+  RleStrip *strip = stream->strip;
+  int y0 = stream->next_row;
+  if (y0 >= header->height) {
+    return NULL;
+  }
+  int num_rows = header->height - y0;
+  if (num_rows > RLE_STREAM_BAND_ROWS) {
+    num_rows = RLE_STREAM_BAND_ROWS;
+  }
+
+  int stride = header->stride;
+  uint8_t *history = strip->data + sizeof(BitmapDataHeader);
+  uint8_t *band = history + RLE_STREAM_HISTORY_ROWS * stride;
+  if (header->format == RLE_FORMAT_ROWS && y0 != 0) {
+    // Keep the rows just above this band, which its rows may refer to.
+    memmove(history, history + RLE_STREAM_BAND_ROWS * stride, RLE_STREAM_HISTORY_ROWS * stride);
+  }
+  memset(band, 0, num_rows * stride);
+
+  // The runs refer to the stream's rbuffer, which may have moved if
+  // the stream was copied since the pass began.
+  stream->runs.rl2.rb = &stream->rb;
+
+  int y = y0;
+  while (y < y0 + num_rows) {
+    int y1 = y0 + num_rows;
+    if (header->format == RLE_FORMAT_BANDS) {
+      int index = y / header->band_rows;
+      if (y == index * header->band_rows) {
+        // The first row of one of the resource's bands, which has its
+        // own run sequence.
+        const uint8_t *offset = stream->rle + header->data_start - (header->num_bands - index) * 2;
+        rle_stream_start_runs(stream, header->data_start + (offset[0] | (offset[1] << 8)));
+      }
+      if (y1 > (index + 1) * header->band_rows) {
+        y1 = (index + 1) * header->band_rows;
+      }
+    }
+    rle_runs_decode(&stream->runs, (uint32_t *)(band + (y - y0) * stride), (y1 - y) * stride * 8);
+    y = y1;
+  }
+
+  if (header->format == RLE_FORMAT_ROWS) {
+    int stride_words = stride / 4;
+    uint32_t *row = (uint32_t *)band;
+    for (int i = 0; i < num_rows; ++i) {
+      rle_undo_row_delta(row, stream->refs[y0 + i], stride_words);
+      row += stride_words;
+    }
+  }
+
+  // Re-aim the strip's GBitmap at the band.
+  GBitmap *bitmap = strip->bitmap;
+  bitmap->addr = band;
+  bitmap->row_size_bytes = stride;
+  bitmap->bounds = GRect(0, 0, header->width, num_rows);
+  strip->y0 = y0;
+  stream->next_row = y0 + num_rows;
+  return bitmap;
+}
@@ -0,0 +1,143 @@
+#ifndef BWD_H
+#define BWD_H
+
+#include <pebble.h>
+
+// A GBitmap along with the data that backs it, so that both can be
+// released together with bwd_destroy().
+typedef struct {
+  GBitmap *bitmap;
+  uint8_t *data;
+} BitmapWithData;
+
+// From bitmapgen.py:
+/*
+# Bitmap struct (NB: All fields are little-endian)
+#         (uint16_t) row_size_bytes
+#         (uint16_t) info_flags
+#                         bit 0 : reserved (must be zero for bitmap files)
+#                    bits 12-15 : file version
+#         (int16_t)  bounds.origin.x
+#         (int16_t)  bounds.origin.y
+#         (int16_t)  bounds.size.w
+#         (int16_t)  bounds.size.h
+#         (uint32_t) image data (word-aligned, 0-padded rows of bits)
+*/
+typedef struct {
+  uint16_t row_size_bytes;
+  uint16_t info_flags;
+  int16_t origin_x;
+  int16_t origin_y;
+  int16_t size_w;
+  int16_t size_h;
+} BitmapDataHeader;
+
+#define RBUFFER_SIZE 256
+typedef struct {
+  ResHandle _rh;
+  size_t _i;
+  size_t _filled_size;
+  size_t _bytes_read;
+  uint8_t *_buffer;
+} RBuffer;
+
+void rbuffer_init(int resource_id, RBuffer *rb);
+void rbuffer_init_offset(int resource_id, RBuffer *rb, size_t offset);
+void rbuffer_init_data(RBuffer *rb, const uint8_t *data, size_t size);
+void rbuffer_seek(RBuffer *rb, size_t offset);
+size_t rbuffer_refill(RBuffer *rb);
+int rbuffer_getc(RBuffer *rb);
+void rbuffer_deinit(RBuffer *rb);
+
+// Used to unpack the integers of an rl2-encoding back into their
+// original rle sequence.  See make_rle.py.  The encoded bits are
+// consumed from the top of a 32-bit reservoir, which is refilled from
+// the RBuffer several bytes at a time.
+typedef struct {
+  RBuffer *rb;
+  int n;
+  int n_shift;        // log2(n)
+  uint32_t bits;      // The next num_bits of input, left-justified.
+  int num_bits;
+} Rl2Unpacker;
+
+void rl2unpacker_init(Rl2Unpacker *rl2, RBuffer *rb, int n);
+int rl2unpacker_getc(Rl2Unpacker *rl2);
+
+BitmapWithData bwd_create(GBitmap *bitmap, void *data);
+BitmapWithData bwd_create_empty(int width, int height);
+BitmapWithData bwd_copy(GBitmap *source);
+void bwd_destroy(BitmapWithData *bwd);
+
+// The format of an rle resource, from the high 4 bits of the n byte
+// of its header.  See make_rle.py.
+#define RLE_FORMAT_PLAIN 0  // A single run sequence for the whole image.
+#define RLE_FORMAT_BANDS 1  // Row-indexed: each band of rows stands alone.
+#define RLE_FORMAT_ROWS 2   // Row-delta: rows XORed with earlier rows.
+
+// The header of an rle resource, as read by rle_header_init().
+typedef struct {
+  int resource_id;
+  ResHandle rh;
+  int width;
+  int height;
+  int stride;
+  int n;
+  int format;
+  int band_rows;      // Rows per band; the whole height for RLE_FORMAT_PLAIN.
+  int num_bands;
+  size_t data_start;  // Offset of the first band's runs within the resource.
+} RleHeader;
+
+// A run sequence being decoded, which may be left partway through a
+// run and resumed later.
+typedef struct {
+  Rl2Unpacker rl2;
+  int value;  // The color of the current run.
+  int count;  // The pixels left in the current run, or EOF.
+} RleRuns;
+
+// An rle resource can also be held in RAM still compressed, in an
+// RleStream, and decoded from the top a band of rows at a time into
+// the small buffer of an RleStrip, rather than all at once into a
+// whole bitmap.  The strip also keeps the rows just above the band,
+// which the rows of a row-delta resource may refer to.
+#define RLE_STREAM_BAND_ROWS 8
+#define RLE_STREAM_HISTORY_ROWS 16  // MAX_ROW_REF in make_rle.py.
+
+typedef struct {
+  uint8_t *data;     // A BitmapDataHeader, the history rows, then the band.
+  int max_stride;
+  GBitmap *bitmap;   // Aimed at the band most recently decoded.
+  int y0;            // The image row of the band's first row.
+} RleStrip;
+
+typedef struct {
+  RleHeader header;
+  uint8_t *rle;      // The whole resource, or NULL if the stream is closed.
+  size_t rle_size;
+  uint8_t *refs;     // Each row's reference, for RLE_FORMAT_ROWS.
+
+  // The pass in progress.
+  RleStrip *strip;
+  RBuffer rb;
+  RleRuns runs;
+  int next_row;
+} RleStream;
+
+void rle_header_init(int resource_id, RleHeader *header);
+void rle_header_init_offset(int resource_id, size_t offset, RleHeader *header);
+void rle_decode_band(RleHeader *header, int band, uint8_t *band_data);
+size_t rle_bitmap_size(RleHeader *header);
+void rle_decode_into(RleHeader *header, uint8_t *bitmap);
+BitmapWithData rle_bwd_create(int resource_id);
+BitmapWithData rle_bwd_create_offset(int resource_id, size_t offset);
+
+bool rle_strip_init(RleStrip *strip, int max_stride);
+void rle_strip_deinit(RleStrip *strip);
+bool rle_stream_open(RleStream *stream, int resource_id);
+void rle_stream_close(RleStream *stream);
+void rle_stream_begin(RleStream *stream, RleStrip *strip);
+GBitmap *rle_stream_next_band(RleStream *stream);
+
+#endif  // BWD_H
@@ -0,0 +1,17 @@
+#ifndef CLOCK_MS_H
+#define CLOCK_MS_H
+
+#include <pebble.h>
+
+// Returns the current time in milliseconds, from time_ms().  This
+// wraps around every 49 days or so, so only the difference between
+// two readings is useful, and deadlines must be compared by their
+// difference too.
+static inline uint32_t clock_now_ms() {
+  time_t seconds;
+  uint16_t ms;
+  time_ms(&seconds, &ms);
+  return (uint32_t)seconds * 1000 + ms;
+}
+
+#endif  // CLOCK_MS_H
@@ -0,0 +1,117 @@
+#include <pebble.h>
+#include "compositor.h"
+
+// A software compositor for the hour wipe.  Rather than drawing each
+// layer of the frame over the last with its own
+// graphics_draw_bitmap_in_rect() pass, we write each word of the
+// framebuffer just once, combining the corresponding words of every
+// layer with the same bit operations the compositing modes would
+// use: Assign for the faces, Clear for the sprite mask, and Or for
+// the sprite and the minutes card.
+//
+// This code doesn't call into the graphics API at all, so it can be
+// built and benchmarked on the host.  As in bitmap_transform.c, we
+// rely on pixel x of a row being bit (x % 32) of word (x / 32), and
+// on rows being word-aligned.
+
+// Returns the mask of the bits of the word beginning at pixel x that
+// fall within pixels a through b - 1.
+static inline uint32_t range_mask(int x, int a, int b) {
+  a -= x;
+  b -= x;
+  if (a >= 32 || b <= 0 || a >= b) {
+    return 0;
+  }
+  uint32_t mask = ~0U;
+  if (a > 0) {
+    mask &= ~0U << a;
+  }
+  if (b < 32) {
+    mask &= (1U << b) - 1;
+  }
+  return mask;
+}
+
+// Returns the 32 pixels of the bitmap's row y beginning at pixel x,
+// which may be negative or beyond the right edge; pixels outside the
+// bitmap are black.
+static inline uint32_t fetch_word(const GBitmap *bitmap, int y, int x) {
+  int width = bitmap->bounds.size.w;
+  if (x >= width || x <= -32) {
+    return 0;
+  }
+  int num_words = bitmap->row_size_bytes / 4;
+  const uint32_t *row = (const uint32_t *)((const uint8_t *)bitmap->addr + y * bitmap->row_size_bytes);
+  int sw = x >> 5;  // rounds toward negative infinity
+  int sb = x & 31;
+  uint32_t lo = (sw >= 0) ? row[sw] : 0;
+  uint32_t value = lo;
+  if (sb != 0) {
+    uint32_t hi = (sw + 1 < num_words) ? row[sw + 1] : 0;
+    value = (lo >> sb) | (hi << (32 - sb));
+  }
+  return value & range_mask(x, 0, width);
+}
+
+// Composes the part of the wipe frame that falls within clip directly
+// into the framebuffer.  fb_data must be the whole screen, of
+// fb_stride bytes per row, and clip must lie within it.
+void compose_wipe(uint8_t *fb_data, int fb_stride, GRect clip, const WipeLayers *layers) {
+  int cx0 = clip.origin.x;
+  int cx1 = clip.origin.x + clip.size.w;
+  if (clip.size.w <= 0 || clip.size.h <= 0) {
+    return;
+  }
+
+  GRect sbox = layers->sprite_box;
+  GRect cbox = layers->card_box;
+  int wipe_x = layers->wipe_x;
+  int face_y0 = layers->face_y0;
+
+  for (int y = clip.origin.y; y < clip.origin.y + clip.size.h; ++y) {
+    uint32_t *dest = (uint32_t *)(fb_data + y * fb_stride);
+    int sy = y - sbox.origin.y;
+    bool sprite_row = (sy >= 0 && sy < sbox.size.h);
+    int ky = y - cbox.origin.y;
+    bool card_row = (layers->card != NULL && ky >= 0 && ky < cbox.size.h);
+
+    for (int wi = cx0 >> 5; wi <= (cx1 - 1) >> 5; ++wi) {
+      int x = wi * 32;
+
+      // The two faces, split at the wipe line.
+      uint32_t left_mask = range_mask(x, x, wipe_x);
+      uint32_t out = 0;
+      if (layers->left != NULL && left_mask != 0) {
+        out |= fetch_word(layers->left, y - face_y0, x) & left_mask;
+      }
+      if (layers->right != NULL && left_mask != ~0U) {
+        out |= fetch_word(layers->right, y - face_y0, x) & ~left_mask;
+      }
+
+      // The sprite, cut into the faces through its mask.
+      if (sprite_row) {
+        uint32_t box_mask = range_mask(x, sbox.origin.x, sbox.origin.x + sbox.size.w);
+        if (box_mask != 0) {
+          int sx = x - sbox.origin.x;
+          if (layers->sprite_mask != NULL) {
+            out &= ~(fetch_word(layers->sprite_mask, sy, sx) & box_mask);
+          }
+          if (layers->sprite != NULL) {
+            out |= fetch_word(layers->sprite, sy, sx) & box_mask;
+          }
+        }
+      }
+
+      // The minutes card, on top.
+      if (card_row) {
+        uint32_t box_mask = range_mask(x, cbox.origin.x, cbox.origin.x + cbox.size.w);
+        if (box_mask != 0) {
+          out |= fetch_word(layers->card, ky, x - cbox.origin.x) & box_mask;
+        }
+      }
+
+      uint32_t clip_mask = range_mask(x, cx0, cx1);
+      dest[wi] = (dest[wi] & ~clip_mask) | (out & clip_mask);
+    }
+  }
+}
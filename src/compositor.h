@@ -0,0 +1,22 @@
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include <pebble.h>
+
+// Everything that goes into a frame of the hour wipe, from the
+// bottom up.  Any of the bitmaps may be NULL.
+typedef struct {
+  GBitmap *left;         // The face to the left of wipe_x (black if NULL).
+  GBitmap *right;        // The face from wipe_x rightward (black if NULL).
+  int wipe_x;
+  int face_y0;           // The screen row of the faces' first row.
+  GBitmap *sprite_mask;  // Cleared out of the faces within sprite_box.
+  GBitmap *sprite;       // Or'ed into the faces within sprite_box.
+  GRect sprite_box;
+  GBitmap *card;         // Or'ed over everything within card_box.
+  GRect card_box;
+} WipeLayers;
+
+void compose_wipe(uint8_t *fb_data, int fb_stride, GRect clip, const WipeLayers *layers);
+
+#endif  // COMPOSITOR_H
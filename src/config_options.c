@@ -12,11 +12,12 @@ void init_default_options() {
   config.second_hand = false;
   config.hour_buzzer = false;
   config.hurt = true;
+  config.low_power = 0;
 }
 
 const char *show_config() {
-  static char buffer[48];
-  snprintf(buffer, 48, "bat: %d, bt: %d, sh: %d, hb: %d, h: %d", config.keep_battery_gauge, config.keep_bluetooth_indicator, config.second_hand, config.hour_buzzer, config.hurt);
+  static char buffer[64];
+  snprintf(buffer, 64, "bat: %d, bt: %d, sh: %d, hb: %d, h: %d, lp: %d", config.keep_battery_gauge, config.keep_bluetooth_indicator, config.second_hand, config.hour_buzzer, config.hurt, config.low_power);
   return buffer;
 }
 
@@ -70,6 +71,11 @@ void receive_config_handler(DictionaryIterator *received, void *context) {
     config.hurt = hurt->value->int32;
   }
 
+  Tuple *low_power = dict_find(received, CK_low_power);
+  if (low_power != NULL) {
+    config.low_power = low_power->value->int32;
+  }
+
   app_log(APP_LOG_LEVEL_INFO, __FILE__, __LINE__, "New config: %s", show_config());
   if (memcmp(&orig_config, &config, sizeof(config)) == 0) {
     app_log(APP_LOG_LEVEL_INFO, __FILE__, __LINE__, "Config is unchanged.");
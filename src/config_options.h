@@ -10,6 +10,7 @@ typedef enum {
   CK_second_hand = 2,
   CK_hour_buzzer = 3,
   CK_hurt = 4,
+  CK_low_power = 5,
 } ConfigKey;
 
 // This key is used to record the persistent storage.
@@ -21,6 +22,7 @@ typedef struct {
   bool second_hand;
   bool hour_buzzer;
   bool hurt;
+  uint8_t low_power;  // Battery percentage at or below which to save power, or 0.
 } __attribute__((__packed__)) ConfigOptions;
 
 extern ConfigOptions config;
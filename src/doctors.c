@@ -1,24 +1,78 @@
 #include <pebble.h>
 #include "assert.h"
+#include "bwd.h"
+#include "bitmap_transform.h"
+#include "compositor.h"
 #include "bluetooth_indicator.h"
 #include "battery_gauge.h"
 #include "config_options.h"
+#include "perf_stats.h"
+#include "heap_stats.h"
+#include "scheduler.h"
+#include "arena.h"
+#include "sprite_atlas.h"
+#include "clock_ms.h"
 
-// Define this during development to make it easier to see animations
-// in a timely fashion.
-//#define FAST_TIME 1
-
-// Define this to enable the FB-grabbing hack, which might break at
-// the next SDK update.
-//#define FB_HACK 1
+// Define this to start the startup wipe from a snapshot of whatever
+// was on the screen before, rather than from black.
+#define FB_SNAPSHOT 1
 
 // Define this to limit the set of sprites to just the Tardis (to
-// reduce resource size).  You also need to remove the other sprites
-// from the resource file, of course.
+// reduce resource size).  You also need to remove the other sprites'
+// atlases from the resource file, of course.
 //#define TARDIS_ONLY 1
 
+// Define this to draw the hour wipe with the single-pass software
+// compositor in compositor.c, writing directly into the framebuffer,
+// instead of with one graphics_draw_bitmap_in_rect() pass per layer.
+#define FB_COMPOSITOR 1
+
+// Define this to keep the faces in RAM still compressed, and decode
+// them a band of rows at a time into a small strip as they are drawn
+// (see RleStream in bwd.h), rather than decoding each into a whole
+// bitmap when it is loaded.  The faces compress only by about a
+// quarter, so this saves just 1K or so of heap at the peak of a
+// transition, at the cost of decoding both faces again with each
+// frame, which makes a frame several times slower to render.
+//#define FACE_STREAMING 1
+
+// Define this to draw the minutes and the colon by blitting the
+// pre-rendered glyphs in resources/digit_*.rle and colon.rle, rather
+// than as text in Bitham 30 Black.  Leave it off until a capture of
+// the firmware's font (see GLYPH_CAPTURE) has been checked in: the
+// glyphs there now are stand-ins, rendered from DejaVu Sans Bold,
+// which doesn't look quite the same.
+//#define MINUTE_GLYPHS 1
+
+// Define this to build, in place of the watchface, the tool that
+// captures the minutes glyphs: it draws each digit and the colon in
+// Bitham 30 Black, just as the minutes and colon layers draw them
+// without MINUTE_GLYPHS, and logs the pixels of each glyph's cell.  Run it in the
+// emulator, and feed its logs to resources/make_glyphs.py, which
+// writes resources/digit_*.png and colon.png.
+//#define GLYPH_CAPTURE 1
+
+#if defined(FB_SNAPSHOT) && defined(FACE_STREAMING)
+// The snapshot is a whole bitmap, which takes the place of the
+// previous face; a streamed face can't hold it.
+#undef FB_SNAPSHOT
+#endif
+
 #define SCREEN_WIDTH 144
 #define SCREEN_HEIGHT 168
+#define SCREEN_RECT GRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT)
+
+// The minutes background card, in the lower-right corner.
+#define MINS_CARD_RECT GRect(SCREEN_WIDTH - 50, SCREEN_HEIGHT - 31, 50, 31)
+
+// The layers that draw the minutes and the colon over the card.
+#define MINUTE_LAYER_RECT GRect(95, 134, 62, 35)
+#define SECOND_LAYER_RECT GRect(95, 134, 16, 35)
+
+// The cells of the minutes glyphs on the card, in the coordinates of
+// minute_layer and second_layer (which share an origin).
+#define COLON_RECT GRect(1, 8, 7, 21)
+#define DIGIT_RECT(i) GRect(10 + (i) * 18, 8, 18, 21)
 
 // The frequency throughout the day at which the buzzer sounds, in seconds.
 #define BUZZER_FREQ 3600
@@ -26,27 +80,94 @@
 // Amount of time, in seconds, to ring the buzzer before the hour.
 #define BUZZER_ANTICIPATE 2
 
-// Number of milliseconds per animation frame
+// Amount of time, in seconds, before the face changes at which to
+// decode the next face and prepare its sprite, so the transition can
+// start without delay.  The face can change on the half-hour, for
+// John Hurt.
+#define PREFETCH_ANTICIPATE 3
+#define FACE_CHANGE_FREQ 1800
+
+// Amount of heap, in bytes, that must remain free while we hold a
+// prefetched transition.  If there's less than this, the prefetch is
+// dropped, and the transition will load everything when it starts.
+#define PREFETCH_HEAP_RESERVE 4096
+
+// The size of a decoded face, with its header.
+#define FACE_BYTES (((SCREEN_WIDTH + 31) / 32) * 4 * SCREEN_HEIGHT + sizeof(BitmapDataHeader))
+
+// A bound on the size of a face held compressed, with its row
+// references (see rle_stream_open()), for FACE_STREAMING.
+#define FACE_RLE_BYTES 3072
+
+// The sizes of the largest sprite mask (the TARDIS masks, 112x168)
+// and the largest sprite (a TARDIS frame, also 112x168), decoded,
+// with headers.
+#define SPRITE_MASK_BYTES (16 * 168 + sizeof(BitmapDataHeader))
+#define SPRITE_BYTES (16 * 168 + sizeof(BitmapDataHeader))
+
+// The slots of the bitmap arena: the current face, and either the
+// previous face (during a transition) or the prefetched next face
+// (before one); then the sprite mask and the sprite, or a frame of
+// the Tardis.  Streamed faces don't need slots.
+static const size_t arena_slot_sizes[] = {
+#ifndef FACE_STREAMING
+  FACE_BYTES, FACE_BYTES,
+#endif  // FACE_STREAMING
+  SPRITE_MASK_BYTES, SPRITE_BYTES,
+};
+#define NUM_ARENA_SLOTS (sizeof(arena_slot_sizes) / sizeof(arena_slot_sizes[0]))
+
+// The Tardis has 7 frames, but only 4 distinct images: the last 3
+// frames mirror the middle ones.  The sprite slot holds one image;
+// we'd like slots for the other 3, so that each can be decoded just
+// once per transition, and one more to mirror frames into (see
+// tardis_frame()).  They're added at the end of handle_init(), once
+// everything else that lives as long as the app has been allocated,
+// and only if at least TARDIS_SLOTS_HEAP_RESERVE bytes of heap remain
+// free afterwards: enough that a prefetch isn't dropped for want of
+// heap, plus a little for the small allocations made as the app runs
+// (timers, incoming config messages).  Images that don't get a slot
+// are decoded as they are drawn.
+#define TARDIS_EXTRA_SLOTS 4
+#define TARDIS_SLOTS_HEAP_RESERVE (PREFETCH_HEAP_RESERVE + 1024)
+
+// Number of milliseconds per animation frame.  The transition runs
+// for this times the number of frames, however long each frame
+// actually takes to draw.
 #define ANIM_TICK_MS 50
 
+// The longest interval, in milliseconds, to which the frame-rate
+// governor will stretch the animation timer when frames are taking
+// too long to render.
+#define MAX_ANIM_TICK_MS 150
+
 // Number of frames of animation
 #define NUM_TRANSITION_FRAMES_HOUR 24
 #define NUM_TRANSITION_FRAMES_STARTUP 10
-
-typedef struct {
-  GBitmap *bitmap;
-  uint8_t *data;
-} BitmapWithData;
+#define NUM_TRANSITION_FRAMES_LOW_POWER 8
 
 Window *window;
 
 BitmapWithData mins_background;
 
-#ifdef FB_HACK
-// The previous framebuffer data.
+#ifdef FB_SNAPSHOT
+// The framebuffer as it was when we were first drawn, until the
+// startup wipe takes it over as the previous face.
 BitmapWithData fb_image;
 bool first_update = true;
-#endif  // FB_HACK
+#endif  // FB_SNAPSHOT
+
+// A face, ready to draw: either a whole bitmap, or, with
+// FACE_STREAMING, the compressed resource, which is decoded into one
+// of face_strips as it is drawn.
+#ifdef FACE_STREAMING
+typedef RleStream Face;
+
+// One strip for each side of the wipe.
+RleStrip face_strips[2];
+#else
+typedef BitmapWithData Face;
+#endif  // FACE_STREAMING
 
 // The horizontal center point of the sprite.
 int sprite_cx = 0;
@@ -57,33 +178,97 @@ Layer *minute_layer; // The minutes indicator.
 Layer *second_layer; // The seconds indicator (a blinking colon).
 
 int face_value;       // The current face on display (or transitioning into)
-BitmapWithData face_image;  // The current face bitmap
+Face face_image;      // The current face
 
 bool face_transition; // True if the face is in transition
 bool wipe_direction;  // True for left-to-right, False for right-to-left.
 bool anim_direction;  // True to reverse tardis rotation.
-int transition_frame; // Frame number of current transition
+int sprite_sel;       // The SPRITE_* of the transition, or the prefetched one.
+uint32_t transition_start_ms;  // When the current transition began
 int num_transition_frames;  // Total frames for transition
+bool static_sprite;   // True to hold the Tardis still rather than spin it.
+
+// True while the battery is low enough that we should save power; see
+// battery_low_power().  We play shorter transitions without animating
+// the Tardis, and don't blink the colon.
+bool low_power;
+
+// The frame-rate governor.  Frames are requested every
+// frame_interval_ms, which starts at ANIM_TICK_MS and is stretched
+// toward MAX_ANIM_TICK_MS while rendering can't keep up with it.
+// This persists from one transition to the next, since it reflects
+// the speed of the hardware.
+int frame_interval_ms = ANIM_TICK_MS;
+int render_ms_avg8;  // Smoothed render time per frame, times 8.
 
 int prev_face_value;  // The face we're transitioning from, or -1.
-BitmapWithData prev_image;  // The previous face bitmap (only during a transition)
+Face prev_image;      // The previous face (only during a transition)
+
+// What the framebuffer holds of the current transition, so that each
+// frame need only redraw what has changed.  The root layer doesn't
+// paint a background, so the face layer's previous frame remains in
+// the framebuffer until we draw over it.
+bool wipe_drawn;        // False if the next frame must be drawn in full.
+int last_wipe_x;        // The wipe line, as of the last frame drawn.
+GRect last_sprite_box;  // The sprite's position, as of the last frame drawn.
 
 // The mask and image for the moving sprite across the wipe.
 BitmapWithData sprite_mask;
 BitmapWithData sprite;
 
-// Triggered at ANIM_TICK_MS intervals for transition animations; also
-// triggered occasionally to check the hour buzzer.
-AppTimer *anim_timer = NULL;
+// The next transition, prepared ahead of time by
+// prefetch_transition().  While prefetch_face_value is not -1, the
+// sprite, sprite_cx, wipe_direction and anim_direction are already
+// set up for it, even though face_transition is false.
+int prefetch_face_value = -1;
+Face prefetch_image;
 
-// Triggered at 500 ms intervals to blink the colon.
-AppTimer *blink_timer = NULL;
+// The bytes of heap the prefetch took, for whatever didn't fit in the
+// arena.  Only these count against PREFETCH_HEAP_RESERVE: what's in
+// the arena's slots costs the heap nothing.
+size_t prefetch_heap_bytes;
+
+// The timed events, all of which share the scheduler's one timer.
+#define EVENT_FRAME     0  // The next frame of the transition animation.
+#define EVENT_BLINK     1  // Blink the colon off, a half-second after drawing it.
+#define EVENT_BUZZER    2  // Ring the buzzer just before the hour.
+#define EVENT_PREFETCH  3  // Prefetch the next transition.
 
 int minute_value;    // The current minute value displayed
 int second_value;    // The current second value displayed.  Actually we only blink the colon, rather than actually display a value, but whatever.
 bool hide_colon;     // Set true every half-second to blink the colon off.
 int last_buzz_hour;  // The hour at which we last sounded the buzzer.
 
+#ifdef MINUTE_GLYPHS
+// The pre-rendered glyphs for the minutes, written by make_glyphs.py
+// from a GLYPH_CAPTURE of Bitham 30 Black (see there for the stand-ins
+// in use until one is checked in), and encoded by make_rle.py.
+BitmapWithData digit_glyphs[10];
+BitmapWithData colon_glyph;
+#endif  // MINUTE_GLYPHS
+
+// What the framebuffer holds of the minutes card, so that the minutes
+// and colon need only be redrawn when they change.  Outside of a
+// transition, the face layer leaves the card alone once it's drawn.
+bool card_drawn;       // False if the face layer must redraw the card.
+int drawn_digits[2];   // The minute digits on the card, or -1 if none.
+bool drawn_colon;      // True if the colon is on the card.
+
+#ifdef MINUTE_GLYPHS
+int digit_resource_ids[10] = {
+  RESOURCE_ID_DIGIT_0,
+  RESOURCE_ID_DIGIT_1,
+  RESOURCE_ID_DIGIT_2,
+  RESOURCE_ID_DIGIT_3,
+  RESOURCE_ID_DIGIT_4,
+  RESOURCE_ID_DIGIT_5,
+  RESOURCE_ID_DIGIT_6,
+  RESOURCE_ID_DIGIT_7,
+  RESOURCE_ID_DIGIT_8,
+  RESOURCE_ID_DIGIT_9,
+};
+#endif  // MINUTE_GLYPHS
+
 int face_resource_ids[13] = {
   RESOURCE_ID_TWELVE,
   RESOURCE_ID_ONE,
@@ -114,292 +299,124 @@ int face_resource_ids[13] = {
 
 #endif  // TARDIS_ONLY
 
-
-typedef struct {
-  int tardis;
-  bool flip_x;
-} TardisFrame;
-
-#define NUM_TARDIS_FRAMES 7
-TardisFrame tardis_frames[NUM_TARDIS_FRAMES] = {
-  { RESOURCE_ID_TARDIS_01, false },
-  { RESOURCE_ID_TARDIS_02, false },
-  { RESOURCE_ID_TARDIS_03, false },
-  { RESOURCE_ID_TARDIS_04, false },
-  { RESOURCE_ID_TARDIS_04, true },
-  { RESOURCE_ID_TARDIS_03, true },
-  { RESOURCE_ID_TARDIS_02, true }
+// The atlas of each sprite (see sprite_atlas.h), which holds its
+// frames, its mask, its center point and its mirrored copy, if any.
+int sprite_atlas_ids[NUM_SPRITES] = {
+  RESOURCE_ID_TARDIS_ATLAS,
+#ifndef TARDIS_ONLY
+  RESOURCE_ID_K9_ATLAS,
+  RESOURCE_ID_DALEK_ATLAS,
+#endif  // TARDIS_ONLY
 };
 
-static const uint32_t tap_segments[] = { 75, 100, 75 };
-VibePattern tap = {
-  tap_segments,
-  3,
-};
+// The atlas of the sprite of the transition (or of the prefetched
+// one), and the way it faces.
+SpriteAtlas sprite_atlas;
+const AtlasFacing *sprite_facing;
+
+// The distinct images of the Tardis frames, each decoded into the
+// arena once for the duration of a transition, so that drawing a
+// frame is just a blit.  An image is NULL if there wasn't a slot for
+// it.  A frame that mirrors its image, or whose image has no slot, is
+// drawn from tardis_scratch instead, which holds the frame most
+// recently made there (tardis_scratch_frame, an atlas image with
+// ATLAS_FLIP_X, or -1 if none).
+BitmapWithData tardis_images[ATLAS_MAX_IMAGES];
+BitmapWithData tardis_scratch;
+int tardis_scratch_frame = -1;
+
+// Returns the indicated frame of the Tardis, copying and mirroring
+// it, or decoding it, into tardis_scratch if need be.  Returns NULL
+// if there isn't enough memory.
+GBitmap *tardis_frame(int af) {
+  int frame = sprite_facing->frames[af];
+  BitmapWithData *image = &tardis_images[frame & ~ATLAS_FLIP_X];
+  if (image->bitmap != NULL && !(frame & ATLAS_FLIP_X)) {
+    return image->bitmap;
+  }
 
-// Reverse the bits of a byte.
-// http://www-graphics.stanford.edu/~seander/bithacks.html#BitReverseTable
-uint8_t reverse_bits(uint8_t b) {
-  return ((b * 0x0802LU & 0x22110LU) | (b * 0x8020LU & 0x88440LU)) * 0x10101LU >> 16; 
-}
-
-// Horizontally flips the indicated GBitmap in-place.  Requires
-// that the width be a multiple of 8 pixels.
-void flip_bitmap_x(GBitmap *image) {
-  int height = image->bounds.size.h;
-  int width = image->bounds.size.w;  // multiple of 8, by our convention.
-  int width_bytes = width / 8;
-  int stride = image->row_size_bytes; // multiple of 4, by Pebble.
-  uint8_t *data = image->addr;
-
-  for (int y = 0; y < height; ++y) {
-    uint8_t *row = data + y * stride;
-    for (int x1 = (width_bytes - 1) / 2; x1 >= 0; --x1) {
-      int x2 = width_bytes - 1 - x1;
-      uint8_t b = reverse_bits(row[x1]);
-      row[x1] = reverse_bits(row[x2]);
-      row[x2] = b;
+  if (frame != tardis_scratch_frame) {
+    // Give back the scratch slot first, so the new frame can take it.
+    bwd_destroy(&tardis_scratch);
+    tardis_scratch_frame = -1;
+    if (image->bitmap != NULL) {
+      tardis_scratch = arena_bwd_copy(image->bitmap);
+    } else {
+      tardis_scratch = sprite_atlas_arena_bwd_create(&sprite_atlas, frame);
+    }
+    if (tardis_scratch.bitmap == NULL) {
+      HEAP_FAILURE(SPRITE_TARDIS, "tardis frame");
+      return NULL;
+    }
+    if (frame & ATLAS_FLIP_X) {
+      bitmap_flip_x(tardis_scratch.bitmap);
     }
+    tardis_scratch_frame = frame;
   }
+  return tardis_scratch.bitmap;
 }
 
-#define RBUFFER_SIZE 256
-typedef struct {
-  ResHandle _rh;
-  size_t _i;
-  size_t _filled_size;
-  size_t _bytes_read;
-  uint8_t *_buffer;
-} RBuffer;
-
-// Begins reading from a raw resource.  Should be matched by a later
-// call to rbuffer_deinit() to free this stuff.
-void rbuffer_init(int resource_id, RBuffer *rb) {
-  rb->_buffer = (uint8_t *)malloc(RBUFFER_SIZE);
-  assert(rb->_buffer != NULL);
-  
-  rb->_rh = resource_get_handle(resource_id);
-  rb->_i = 0;
-  rb->_filled_size = resource_load_byte_range(rb->_rh, 0, rb->_buffer, RBUFFER_SIZE);
-  rb->_bytes_read = rb->_filled_size;
-}
-
-// Gets the next byte from the rbuffer.  Returns EOF at end.
-int rbuffer_getc(RBuffer *rb) {
-  if (rb->_i >= RBUFFER_SIZE) {
-    rb->_filled_size = resource_load_byte_range(rb->_rh, rb->_bytes_read, rb->_buffer, RBUFFER_SIZE);
-    rb->_bytes_read += rb->_filled_size;
-    rb->_i = 0;
-  }
-  if (rb->_i >= rb->_filled_size) {
-    return EOF;
-  }
-
-  int result = rb->_buffer[rb->_i];
-  rb->_i++;
-  return result;
-}
-
-// Frees the resources reserved in rbuffer_init().
-void rbuffer_deinit(RBuffer *rb) {
-  assert(rb->_buffer != NULL);
-  free(rb->_buffer);
-  rb->_buffer = NULL;
-}
-
-// From bitmapgen.py:
-/*
-# Bitmap struct (NB: All fields are little-endian)
-#         (uint16_t) row_size_bytes
-#         (uint16_t) info_flags
-#                         bit 0 : reserved (must be zero for bitmap files)
-#                    bits 12-15 : file version
-#         (int16_t)  bounds.origin.x
-#         (int16_t)  bounds.origin.y
-#         (int16_t)  bounds.size.w
-#         (int16_t)  bounds.size.h
-#         (uint32_t) image data (word-aligned, 0-padded rows of bits)
-*/
-typedef struct {
-  uint16_t row_size_bytes;
-  uint16_t info_flags;
-  int16_t origin_x;
-  int16_t origin_y;
-  int16_t size_w;
-  int16_t size_h;
-} BitmapDataHeader;
-
-BitmapWithData bwd_create(GBitmap *bitmap, void *data) {
-  BitmapWithData bwd;
-  bwd.bitmap = bitmap;
-  bwd.data = data;
-  return bwd;
-}
-
-void bwd_destroy(BitmapWithData *bwd) {
-  if (bwd->bitmap != NULL) {
-    gbitmap_destroy(bwd->bitmap);
-    bwd->bitmap = NULL;
-  }
-  if (bwd->data != NULL) {
-    free(bwd->data);
-    bwd->data = NULL;
-  }
-}
-
-// Used to unpack the integers of an rl2-encoding back into their
-// original rle sequence.  See make_rle.py.
-typedef struct {
-  RBuffer *rb;
-  int n;
-  int b;
-  int bi;
-} Rl2Unpacker;
-
-void rl2unpacker_init(Rl2Unpacker *rl2, RBuffer *rb, int n) {
-  // assumption: n is an integer divisor of 8.
-  assert(n * (8 / n) == 8);
-
-  rl2->rb = rb;
-  rl2->n = n;
-  rl2->b = rbuffer_getc(rb);
-  rl2->bi = 8;
-}
-
-// Gets the next integer from the rl2 encoding.  Returns EOF at end.
-int rl2unpacker_getc(Rl2Unpacker *rl2) {
-  if (rl2->b == EOF) {
-    return EOF;
-  }
-
-  // First, count the number of zero chunks until we come to a nonzero chunk.
-  int zero_count = 0;
-  int bmask = (1 << rl2->n) - 1;
-  int bv = (rl2->b & (bmask << (rl2->bi - rl2->n)));
-  while (bv == 0) {
-    ++zero_count;
-    rl2->bi -= rl2->n;
-    if (rl2->bi <= 0) {
-      rl2->b = rbuffer_getc(rl2->rb);
-      rl2->bi = 8;
-      if (rl2->b == EOF) {
-        return EOF;
-      }
-    }
-    bv = (rl2->b & (bmask << (rl2->bi - rl2->n)));
+// Decodes as many of the distinct images of the Tardis frames as the
+// arena's sprite slots have room for.  One slot is kept back for
+// tardis_scratch, unless no frame will need it; and it's taken now,
+// with the first frame to be drawn, so that nothing else can claim it
+// before the transition starts.  In low-power mode, the Tardis holds
+// still on frame 0 (see static_sprite), so that's the only one decoded.
+void tardis_frames_init() {
+  if (low_power) {
+    tardis_frame(0);
+    return;
   }
 
-  // Infer from that the number of chunks, and hence the number of
-  // bits, that make up the value we will extract.
-  int num_chunks = (zero_count + 1);
-  int bit_count = num_chunks * rl2->n;
-
-  // OK, now we need to extract the next bitCount bits into a word.
-  int result = 0;
-  while (bit_count >= rl2->bi) {
-    int mask = (1 << rl2->bi) - 1;
-    int value = (rl2->b & mask);
-    result = (result << rl2->bi) | value;
-    bit_count -= rl2->bi;
-
-    rl2->b = rbuffer_getc(rl2->rb);
-    rl2->bi = 8;
-    if (rl2->b == EOF) {
-      break;
+  int num_frames = sprite_atlas.num_frames;
+  int num_images = 0;
+  bool any_flipped = false;
+  bool wanted[ATLAS_MAX_IMAGES];
+  memset(wanted, 0, sizeof(wanted));
+  for (int af = 0; af < num_frames; ++af) {
+    int image = sprite_facing->frames[af] & ~ATLAS_FLIP_X;
+    if (!wanted[image]) {
+      wanted[image] = true;
+      ++num_images;
+    }
+    if (sprite_facing->frames[af] & ATLAS_FLIP_X) {
+      any_flipped = true;
     }
   }
 
-  if (bit_count > 0) {
-    // A partial word in the middle of the byte.
-    int bottom_count = rl2->bi - bit_count;
-    assert(bottom_count > 0);
-    int mask = ((1 << bit_count) - 1);
-    int value = ((rl2->b >> bottom_count) & mask);
-    result = (result << bit_count) | value;
-    rl2->bi -= bit_count;
+  int num_slots = arena_num_free(SPRITE_BYTES);
+  if (any_flipped || num_images > num_slots) {
+    --num_slots;
   }
-
-  return result;
-}
-  
-
-// Initialize a bitmap from an rle-encoded resource.  The returned
-// bitmap must be released with bwd_destroy().  See make_rle.py for
-// the program that generates these rle sequences.
-BitmapWithData
-rle_bwd_create(int resource_id) {
-  RBuffer rb;
-  rbuffer_init(resource_id, &rb);
-  int width = rbuffer_getc(&rb);
-  int height = rbuffer_getc(&rb);
-  int stride = rbuffer_getc(&rb);
-  int n = rbuffer_getc(&rb);
-
-  Rl2Unpacker rl2;
-  rl2unpacker_init(&rl2, &rb, n);
-
-  size_t data_size = height * stride;
-  size_t total_size = sizeof(BitmapDataHeader) + data_size;
-  uint8_t *bitmap = (uint8_t *)malloc(total_size);
-  assert(bitmap != NULL);
-  memset(bitmap, 0, total_size);
-  BitmapDataHeader *bitmap_header = (BitmapDataHeader *)bitmap;
-  uint8_t *bitmap_data = bitmap + sizeof(BitmapDataHeader);
-  bitmap_header->row_size_bytes = stride;
-  bitmap_header->size_w = width;
-  bitmap_header->size_h = height;
-
-  // The initial value is 0.
-  uint8_t *dp = bitmap_data;
-  uint8_t *dp_stop = dp + stride * height;
-  int value = 0;
-  int b = 0;
-  int count = rl2unpacker_getc(&rl2);
-  assert(count > 0);
-  // We discard the first, implicit black pixel; it's not part of the image.
-  --count;
-  while (count != EOF) {
-    assert(dp < dp_stop);
-    if (value) {
-      // Generate count 1-bits.
-      int b1 = b + count;
-      if (b1 < 8) {
-        // We're still within the same byte.
-        int mask = ~((1 << (b)) - 1);
-        mask &= ((1 << (b1)) - 1);
-        *dp |= mask;
-        b = b1;
-      } else {
-        // We've crossed over a byte boundary.
-        *dp |= ~((1 << (b)) - 1);
-        ++dp;
-        b += 8;
-        while (b1 / 8 != b / 8) {
-          assert(dp < dp_stop);
-          *dp = 0xff;
-          ++dp;
-          b += 8;
-        }
-        b1 = b1 % 8;
-        assert(dp < dp_stop);
-        *dp |= ((1 << (b1)) - 1);
-        b = b1;
+  for (int image = 0; image < ATLAS_MAX_IMAGES && num_slots > 0; ++image) {
+    if (wanted[image]) {
+      tardis_images[image] = sprite_atlas_arena_bwd_create(&sprite_atlas, image);
+      if (tardis_images[image].bitmap == NULL) {
+        HEAP_FAILURE(SPRITE_TARDIS, "tardis frame");
       }
-    } else {
-      // Skip over count 0-bits.
-      b += count;
-      dp += b / 8;
-      b = b % 8;
+      --num_slots;
     }
-    value = 1 - value;
-    count = rl2unpacker_getc(&rl2);
   }
-  rbuffer_deinit(&rb);
 
-  GBitmap *image = gbitmap_create_with_data(bitmap);
-  return bwd_create(image, bitmap);
+  tardis_frame(anim_direction ? num_frames - 1 : 0);
 }
 
+// Releases everything decoded by tardis_frames_init() and
+// tardis_frame().
+void tardis_frames_deinit() {
+  for (int image = 0; image < ATLAS_MAX_IMAGES; ++image) {
+    bwd_destroy(&tardis_images[image]);
+  }
+  bwd_destroy(&tardis_scratch);
+  tardis_scratch_frame = -1;
+}
+
+static const uint32_t tap_segments[] = { 75, 100, 75 };
+VibePattern tap = {
+  tap_segments,
+  3,
+};
+
 int check_buzzer() {
   // Rings the buzzer if it's almost time for the hour to change.
   // Returns the amount of time in ms to wait for the next buzzer.
@@ -426,219 +443,557 @@ int check_buzzer() {
   return (next_buzzer_time - now) * 1000;
 }
 
-void set_next_timer();
+void schedule_next_frame();
+int check_prefetch();
 
-// Triggered at ANIM_TICK_MS intervals for transition animations; also
-// triggered occasionally to check the hour buzzer.
-void handle_timer(void *data) {
-  anim_timer = NULL;  // When the timer is handled, it is implicitly canceled.
+// Returns the number of milliseconds since the current transition
+// began.
+int get_transition_elapsed_ms() {
+  return (int)(clock_now_ms() - transition_start_ms);
+}
 
+// Feeds the time taken to render the last transition frame to the
+// frame-rate governor, which lowers the frame rate while frames take
+// more than 3/4 of the frame interval to render, and raises it again
+// once they take less than half.
+void govern_frame_rate(int render_ms) {
+  render_ms_avg8 += render_ms - render_ms_avg8 / 8;
+  int avg_ms = render_ms_avg8 / 8;
+  if (avg_ms * 4 > frame_interval_ms * 3 && frame_interval_ms < MAX_ANIM_TICK_MS) {
+    frame_interval_ms += ANIM_TICK_MS / 5;
+  } else if (avg_ms * 2 < frame_interval_ms && frame_interval_ms > ANIM_TICK_MS) {
+    frame_interval_ms -= ANIM_TICK_MS / 5;
+  }
+}
+
+// Triggered at frame_interval_ms intervals during a transition.
+void handle_frame() {
   if (face_transition) {
     layer_mark_dirty(face_layer);
+    schedule_next_frame();
   }
+}
 
-  set_next_timer();
+// Arms the timer for the next frame of the transition, at the next
+// multiple of frame_interval_ms since the transition began.  Since
+// the animation's progress depends only on the time, a frame that is
+// late doesn't delay the ones after it.
+void schedule_next_frame() {
+  int elapsed_ms = get_transition_elapsed_ms();
+  int next_frame_ms = frame_interval_ms - elapsed_ms % frame_interval_ms;
+  scheduler_set(EVENT_FRAME, next_frame_ms, &handle_frame);
 }
 
-// Triggered at 500 ms intervals to blink the colon.
-void handle_blink(void *data) {
-  blink_timer = NULL;  // When the timer is handled, it is implicitly canceled.
+// Returns true if we should blink the colon every second.
+bool colon_blinks() {
+  return config.second_hand && !low_power;
+}
 
-  if (config.second_hand) {
+// Triggered a half-second after each second, to blink the colon.
+void handle_blink() {
+  if (colon_blinks()) {
     hide_colon = true;
     layer_mark_dirty(second_layer);
   }
-
-  if (blink_timer != NULL) {
-    app_timer_cancel(blink_timer);
-    blink_timer = NULL;
-  }
 }
 
-// Ensures the animation/buzzer timer is running.
-void set_next_timer() {
-  if (anim_timer != NULL) {
-    app_timer_cancel(anim_timer);
-    anim_timer = NULL;
-  }
-  int next_buzzer_ms = check_buzzer();
-
-  if (face_transition) {
-    // If the animation is underway, we need to fire the timer at
-    // ANIM_TICK_MS intervals.
-    anim_timer = app_timer_register(ANIM_TICK_MS, &handle_timer, 0);
-
-  } else {
-    // Otherwise, we only need a timer to tell us to buzz at (almost)
-    // the top of the hour.
-    anim_timer = app_timer_register(next_buzzer_ms, &handle_timer, 0);
-  }
+// Triggered just before the top of every hour.
+void handle_buzzer() {
+  scheduler_set(EVENT_BUZZER, check_buzzer(), &handle_buzzer);
 }
 
-#ifdef FB_HACK
-// Hack alert!  This is an opaque data structure, but we're looking
-// inside it anyway.  Idea taken from
-// http://memention.com/blog/2013/07/20/Yak-shaving-a-Pebble.html .
-struct GContext {
-  uint8_t *framebuffer;
-};
+// Triggered shortly before each time the face might change.
+void handle_prefetch() {
+  scheduler_set(EVENT_PREFETCH, check_prefetch(), &handle_prefetch);
+}
 
-// Initializes the indicated GBitmap with a copy of the current
-// framebuffer data.  Hacky!  Free it later with bwd_destroy().
-BitmapWithData
-fb_bwd_create(struct GContext *ctx) {
-  int width = SCREEN_WIDTH;
-  int height = SCREEN_HEIGHT;
-  int stride = ((width + 31) / 32) * 4;
+// Loads the indicated face into face.  If there isn't enough memory,
+// face_loaded() will return false.
+void face_load(Face *face, int face_new) {
+#ifdef FACE_STREAMING
+  rle_stream_open(face, face_resource_ids[face_new]);
+#else
+  *face = arena_rle_bwd_create(face_resource_ids[face_new]);
+#endif  // FACE_STREAMING
+}
 
-  size_t data_size = height * stride;
-  size_t total_size = sizeof(BitmapDataHeader) + data_size;
-  uint8_t *bitmap = (uint8_t *)malloc(total_size);
-  assert(bitmap != NULL);
-  memset(bitmap, 0, total_size);
-  BitmapDataHeader *bitmap_header = (BitmapDataHeader *)bitmap;
-  uint8_t *bitmap_data = bitmap + sizeof(BitmapDataHeader);
-  bitmap_header->row_size_bytes = stride;
-  bitmap_header->size_w = width;
-  bitmap_header->size_h = height;
+bool face_loaded(const Face *face) {
+#ifdef FACE_STREAMING
+  return face->rle != NULL;
+#else
+  return face->bitmap != NULL;
+#endif  // FACE_STREAMING
+}
 
-  // This doesn't appear to be working yet.  Not sure where I should
-  // be finding this data.
-  uint8_t *framebuffer = ctx->framebuffer;
-  memcpy(bitmap_data, framebuffer, stride * height);
+// Forgets the face, which has been moved elsewhere, without freeing it.
+void face_clear(Face *face) {
+#ifdef FACE_STREAMING
+  face->rle = NULL;
+  face->refs = NULL;
+#else
+  face->bitmap = NULL;
+  face->data = NULL;
+#endif  // FACE_STREAMING
+}
 
-  GBitmap *image = gbitmap_create_with_data(bitmap);
-  return bwd_create(image, bitmap);
+void face_destroy(Face *face) {
+#ifdef FACE_STREAMING
+  rle_stream_close(face);
+#else
+  bwd_destroy(face);
+#endif  // FACE_STREAMING
 }
-#endif  // FB_HACK
 
+// Returns true if there's room to load another face.
+bool face_has_room() {
+#ifdef FACE_STREAMING
+  return heap_bytes_free() >= FACE_RLE_BYTES + PREFETCH_HEAP_RESERVE;
+#else
+  return arena_has_room(FACE_BYTES) || heap_bytes_free() >= FACE_BYTES + PREFETCH_HEAP_RESERVE;
+#endif  // FACE_STREAMING
+}
 
 void stop_transition() {
   face_transition = false;
+  HEAP_SAMPLE(HEAP_AT_STOP);
 
   // Release the transition resources.
-  bwd_destroy(&prev_image);
+  face_destroy(&prev_image);
   bwd_destroy(&sprite_mask);
   bwd_destroy(&sprite);
+  tardis_frames_deinit();
 
-#ifdef FB_HACK
+#ifdef FB_SNAPSHOT
   bwd_destroy(&fb_image);
-#endif  // FB_HACK
+#endif  // FB_SNAPSHOT
 
   // Stop the transition timer.
-  if (anim_timer != NULL) {
-    app_timer_cancel(anim_timer);
-    anim_timer = NULL;
+  scheduler_cancel(EVENT_FRAME);
+
+#ifdef PERF_STATS
+  perf_log_summary();
+#endif  // PERF_STATS
+#ifdef HEAP_STATS
+  heap_stats_log_summary();
+#endif  // HEAP_STATS
+}
+
+// Chooses the sprite and the directions for the next transition, and
+// loads the sprite.
+void prepare_sprite(bool for_startup) {
+  if (for_startup) {
+    // Force the right-to-left TARDIS transition at startup.
+    wipe_direction = false;
+    sprite_sel = 0;
+    anim_direction = false;
+
+  } else {
+    // Choose a random transition at the top of the hour.
+    wipe_direction = (rand() % 2) != 0;    // Sure, it's not 100% even, but whatever.
+    sprite_sel = (rand() % NUM_SPRITES);
+    anim_direction = (rand() % 2) != 0;
+  }
+
+  // Initialize the sprite.  Going left-to-right, we use the
+  // pre-mirrored copy, if the sprite has one.
+  sprite_atlas_init(&sprite_atlas, sprite_atlas_ids[sprite_sel]);
+  sprite_facing = sprite_atlas_facing(&sprite_atlas, wipe_direction);
+  sprite_cx = sprite_facing->cx;
+  sprite_mask = sprite_atlas_arena_bwd_create(&sprite_atlas, sprite_facing->mask);
+  if (sprite_atlas.num_frames > 1) {
+    // The Tardis, which is animated.
+    tardis_frames_init();
+  } else {
+    sprite = sprite_atlas_arena_bwd_create(&sprite_atlas, sprite_facing->frames[0]);
+    if (sprite.bitmap != NULL && (sprite_facing->frames[0] & ATLAS_FLIP_X)) {
+      bitmap_flip_x(sprite.bitmap);
+    }
+  }
+
+  if (sprite_mask.bitmap == NULL) {
+    HEAP_FAILURE(sprite_sel, "sprite mask");
+  }
+  if (sprite_atlas.num_frames == 1 && sprite.bitmap == NULL) {
+    HEAP_FAILURE(sprite_sel, "sprite");
+  }
+}
+
+// Releases a transition prepared by prefetch_transition() but never
+// started.
+void drop_prefetch() {
+  if (prefetch_face_value == -1) {
+    return;
+  }
+  prefetch_face_value = -1;
+  face_destroy(&prefetch_image);
+  bwd_destroy(&sprite_mask);
+  bwd_destroy(&sprite);
+  tardis_frames_deinit();
+}
+
+// Decodes the indicated face and prepares a sprite for it, ahead of
+// the transition to it.  If it doesn't all fit in the arena, and the
+// heap runs short, we give up, and start_transition() will do it all
+// itself.
+void prefetch_transition(int face_new) {
+  assert(!face_transition);
+  drop_prefetch();
+  if (!face_has_room()) {
+    return;
+  }
+
+  size_t free_before = heap_bytes_free();
+  prefetch_face_value = face_new;
+  face_load(&prefetch_image, face_new);
+  prepare_sprite(false);
+
+  size_t free_after = heap_bytes_free();
+  prefetch_heap_bytes = (free_after < free_before) ? free_before - free_after : 0;
+  if (prefetch_heap_bytes != 0 && free_after < PREFETCH_HEAP_RESERVE) {
+    drop_prefetch();
+  }
+}
+
+// Returns the face to display at the indicated time.
+int face_for_time(struct tm *tm) {
+  int face = tm->tm_hour % 12;
+  if (config.hurt && face == 8 && tm->tm_min >= 30) {
+    // Face 8.5 is John Hurt.
+    face = 12;
+  }
+  return face;
+}
+
+// Drops a prefetched transition if the heap is running short, and
+// the prefetch is holding some of it.
+void check_prefetch_heap() {
+  if (prefetch_face_value != -1 && prefetch_heap_bytes != 0 &&
+      heap_bytes_free() < PREFETCH_HEAP_RESERVE) {
+    drop_prefetch();
+  }
+}
+
+// Prefetches the next transition if the face is about to change.
+// Returns the amount of time in ms to wait for the next prefetch.
+int check_prefetch() {
+  time_t now = time(NULL);
+
+  check_prefetch_heap();
+  if (!face_transition && face_value != -1) {
+    time_t soon = now + PREFETCH_ANTICIPATE;
+    int face_soon = face_for_time(localtime(&soon));
+    if (face_soon != face_value && face_soon != prefetch_face_value) {
+      prefetch_transition(face_soon);
+    }
   }
+
+  int next_change = ((now + PREFETCH_ANTICIPATE) / FACE_CHANGE_FREQ + 1) * FACE_CHANGE_FREQ;
+  return (next_change - PREFETCH_ANTICIPATE - now) * 1000;
 }
 
 void start_transition(int face_new, bool for_startup) {
+  PERF_BEGIN(start);
   if (face_transition) {
     stop_transition();
   }
 
+  // Use the prefetched face and sprite if we have them; otherwise
+  // make room to load them now.
+  bool prefetched = (!for_startup && prefetch_face_value == face_new);
+  if (!prefetched) {
+    drop_prefetch();
+  }
+
   // Update the face display.
-  assert(prev_image.bitmap == NULL);
+  assert(!face_loaded(&prev_image));
   prev_face_value = face_value;
   prev_image = face_image;
 
   face_value = face_new;
-  face_image = rle_bwd_create(face_resource_ids[face_value]);
+  if (prefetched) {
+    face_image = prefetch_image;
+    face_clear(&prefetch_image);
+    prefetch_face_value = -1;
+  } else {
+    face_load(&face_image, face_value);
+  }
 
   face_transition = true;
-  transition_frame = 0;
+  wipe_drawn = false;
   num_transition_frames = NUM_TRANSITION_FRAMES_HOUR;
+  static_sprite = false;
+  if (low_power) {
+    num_transition_frames = NUM_TRANSITION_FRAMES_LOW_POWER;
+    static_sprite = true;
+  }
 
-  int sprite_sel;
+  // We used to want the startup transition to go super-fast, to match
+  // the speed of the system wipe, but we no longer try to do this
+  // (since the system wipe is different nowadays anyway).
+  //if (for_startup) num_transition_frames = NUM_TRANSITION_FRAMES_STARTUP;
 
-  if (for_startup) {
-    // Force the right-to-left TARDIS transition at startup.
-    wipe_direction = false;
-    sprite_sel = 0;
-    anim_direction = false;
+  if (!prefetched) {
+    prepare_sprite(for_startup);
+  }
+  if (!face_loaded(&face_image)) {
+    HEAP_FAILURE(sprite_sel, "face");
+  }
+  HEAP_BEGIN(sprite_sel);
 
-    // We used to want this to go super-fast at startup, to match the
-    // speed of the system wipe, but we no longer try to do this
-    // (since the system wipe is different nowadays anyway).
-    //num_transition_frames = NUM_TRANSITION_FRAMES_STARTUP;
+  // Start the transition timer.  We start the clock only now, after
+  // the decoding above, so it doesn't eat into the animation.
+  transition_start_ms = clock_now_ms();
+  layer_mark_dirty(face_layer);
+  schedule_next_frame();
+  PERF_END(PERF_START_TRANSITION, start);
+}
+
+void root_layer_update_callback(Layer *me, GContext* ctx) {
+#ifdef FB_SNAPSHOT
+  if (fb_image.bitmap == NULL && first_update) {
+    // The root layer is drawn before any of its children, so the
+    // framebuffer still holds whatever was on the screen before us.
+    // The wipe will draw over it, so we need a copy; it goes into the
+    // arena's free face slot.
+    first_update = false;
+    GBitmap *fb = graphics_capture_frame_buffer(ctx);
+    if (fb != NULL) {
+      fb_image = arena_bwd_copy(fb);
+      graphics_release_frame_buffer(ctx, fb);
+    }
+  }
+#endif  // FB_SNAPSHOT
+}
 
+// Returns the smallest rectangle that contains both a and b.
+GRect grect_union(GRect a, GRect b) {
+  int x0 = (a.origin.x < b.origin.x) ? a.origin.x : b.origin.x;
+  int y0 = (a.origin.y < b.origin.y) ? a.origin.y : b.origin.y;
+  int ax1 = a.origin.x + a.size.w;
+  int bx1 = b.origin.x + b.size.w;
+  int ay1 = a.origin.y + a.size.h;
+  int by1 = b.origin.y + b.size.h;
+  int x1 = (ax1 > bx1) ? ax1 : bx1;
+  int y1 = (ay1 > by1) ? ay1 : by1;
+  return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+// Draws just the part of the bitmap that falls within clip, given
+// that the whole bitmap would be drawn at destination.  This uses a
+// temporary sub-bitmap on the stack, which shares the original's
+// data, rather than allocating one with gbitmap_create_as_sub_bitmap().
+void draw_bitmap_clipped(GContext *ctx, GBitmap *bitmap, GRect destination, GRect clip) {
+  grect_clip(&clip, &destination);
+  if (grect_is_empty(&clip)) {
+    return;
+  }
+
+  GBitmap sub = *bitmap;
+  sub.bounds.origin.x += clip.origin.x - destination.origin.x;
+  sub.bounds.origin.y += clip.origin.y - destination.origin.y;
+  sub.bounds.size = clip.size;
+  graphics_draw_bitmap_in_rect(ctx, &sub, clip);
+}
+
+// Draws the part of the face image that falls within clip and also
+// within area.  The image holds the face's rows from screen row
+// face_y0 down.  If there is no face image, we draw black there.
+void draw_face_clipped(GContext *ctx, GBitmap *image, int face_y0, GRect area, GRect clip) {
+  grect_clip(&clip, &area);
+  if (grect_is_empty(&clip)) {
+    return;
+  }
+
+  if (image != NULL) {
+    graphics_context_set_compositing_mode(ctx, GCompOpAssign);
+    draw_bitmap_clipped(ctx, image, GRect(0, face_y0, SCREEN_WIDTH, image->bounds.size.h), clip);
   } else {
-    // Choose a random transition at the top of the hour.
-    wipe_direction = (rand() % 2) != 0;    // Sure, it's not 100% even, but whatever.
-    sprite_sel = (rand() % NUM_SPRITES);
-    anim_direction = (rand() % 2) != 0;
+    graphics_context_set_fill_color(ctx, GColorBlack);
+    graphics_fill_rect(ctx, clip, 0, GCornerNone);
   }
+}
 
-  // Initialize the sprite.
-  switch (sprite_sel) {
-  case SPRITE_TARDIS:
-    sprite_mask = rle_bwd_create(RESOURCE_ID_TARDIS_MASK);
-    
-    sprite_cx = 72;
-    break;
+// Draws the part of the current wipe frame that falls within clip,
+// one layer at a time: the new face on one side of the wipe line and
+// the previous face on the other, then the sprite over the wipe line,
+// then the minutes card.
+void draw_wipe_rect(GContext *ctx, GRect clip, const WipeLayers *layers) {
+  GRect screen = SCREEN_RECT;
+  grect_clip(&clip, &screen);
+  if (grect_is_empty(&clip)) {
+    return;
+  }
 
-#ifndef TARDIS_ONLY
-  case SPRITE_K9:
-    sprite_mask = rle_bwd_create(RESOURCE_ID_K9_MASK);
-    sprite = rle_bwd_create(RESOURCE_ID_K9);
-    sprite_cx = 41;
+  int wipe_x = layers->wipe_x;
+  int left_w = (wipe_x < 0) ? 0 : (wipe_x > SCREEN_WIDTH) ? SCREEN_WIDTH : wipe_x;
+  draw_face_clipped(ctx, layers->left, layers->face_y0, GRect(0, 0, left_w, SCREEN_HEIGHT), clip);
+  draw_face_clipped(ctx, layers->right, layers->face_y0, GRect(left_w, 0, SCREEN_WIDTH - left_w, SCREEN_HEIGHT), clip);
+
+  // Then, draw the sprite on top of the wipe line.
+  graphics_context_set_compositing_mode(ctx, GCompOpClear);
+  draw_bitmap_clipped(ctx, layers->sprite_mask, layers->sprite_box, clip);
+  if (layers->sprite != NULL) {
+    graphics_context_set_compositing_mode(ctx, GCompOpOr);
+    draw_bitmap_clipped(ctx, layers->sprite, layers->sprite_box, clip);
+  }
 
-    if (wipe_direction) {
-      flip_bitmap_x(sprite_mask.bitmap);
-      flip_bitmap_x(sprite.bitmap);
-      sprite_cx = sprite.bitmap->bounds.size.w - sprite_cx;
+  // Finally, re-draw the minutes background card on top of the sprite.
+  graphics_context_set_compositing_mode(ctx, GCompOpOr);
+  draw_bitmap_clipped(ctx, layers->card, layers->card_box, clip);
+}
+
+// Draws the parts of the current wipe frame that fall within each of
+// the given rects.
+void draw_wipe(GContext *ctx, const GRect *rects, int num_rects, const WipeLayers *layers) {
+#ifdef FB_COMPOSITOR
+  GBitmap *fb = graphics_capture_frame_buffer(ctx);
+  if (fb != NULL) {
+    GRect screen = SCREEN_RECT;
+    for (int i = 0; i < num_rects; ++i) {
+      GRect clip = rects[i];
+      grect_clip(&clip, &screen);
+      if (!grect_is_empty(&clip)) {
+        compose_wipe((uint8_t *)fb->addr, fb->row_size_bytes, clip, layers);
+      }
     }
-    break;
+    graphics_release_frame_buffer(ctx, fb);
+    return;
+  }
+#endif  // FB_COMPOSITOR
 
-  case SPRITE_DALEK:
-    sprite_mask = rle_bwd_create(RESOURCE_ID_DALEK_MASK);
-    sprite = rle_bwd_create(RESOURCE_ID_DALEK);
-    sprite_cx = 74;
+  // No direct access to the framebuffer; do it the slow way.
+  for (int i = 0; i < num_rects; ++i) {
+    draw_wipe_rect(ctx, rects[i], layers);
+  }
+}
 
-    if (wipe_direction) {
-      flip_bitmap_x(sprite_mask.bitmap);
-      flip_bitmap_x(sprite.bitmap);
-      sprite_cx = sprite.bitmap->bounds.size.w - sprite_cx;
+// Draws the parts of the face that fall within each of the given
+// clips, given that the whole face would be drawn at destination,
+// with the current compositing mode.
+void draw_face(GContext *ctx, Face *face, GRect destination, const GRect *clips, int num_clips) {
+#ifdef FACE_STREAMING
+  // Decode the face from the top, just as far as the lowest clip.
+  int y1 = 0;
+  for (int i = 0; i < num_clips; ++i) {
+    int bottom = clips[i].origin.y + clips[i].size.h;
+    y1 = (bottom > y1) ? bottom : y1;
+  }
+  RleStrip *strip = &face_strips[0];
+  rle_stream_begin(face, strip);
+  GBitmap *band;
+  while ((band = rle_stream_next_band(face)) != NULL) {
+    GRect band_rect = GRect(destination.origin.x, destination.origin.y + strip->y0,
+                            destination.size.w, band->bounds.size.h);
+    for (int i = 0; i < num_clips; ++i) {
+      draw_bitmap_clipped(ctx, band, band_rect, clips[i]);
+    }
+    if (band_rect.origin.y + band_rect.size.h >= y1) {
+      break;
     }
-    break;
-#endif  // TARDIS_ONLY
   }
-
-  // Start the transition timer.
-  layer_mark_dirty(face_layer);
-  set_next_timer();
+#else
+  for (int i = 0; i < num_clips; ++i) {
+    draw_bitmap_clipped(ctx, face->bitmap, destination, clips[i]);
+  }
+#endif  // FACE_STREAMING
 }
 
-void root_layer_update_callback(Layer *me, GContext* ctx) {
-#ifdef FB_HACK
-  if (fb_image.bitmap == NULL && first_update) {
-    first_update = false;
-    fb_image = fb_bwd_create(ctx);
+// Draws the parts of the current wipe frame that fall within each of
+// the given rects, as draw_wipe() does, with the left and right faces
+// as layers->left and layers->right.  Streamed faces are decoded a
+// band at a time, and each band of the frame composed in turn.
+void draw_wipe_faces(GContext *ctx, const GRect *rects, int num_rects, WipeLayers *layers,
+                     Face *left, Face *right) {
+#ifdef FACE_STREAMING
+  int y1 = 0;
+  for (int i = 0; i < num_rects; ++i) {
+    int bottom = rects[i].origin.y + rects[i].size.h;
+    y1 = (bottom > y1) ? bottom : y1;
   }
-#endif
+  if (y1 > SCREEN_HEIGHT) {
+    y1 = SCREEN_HEIGHT;
+  }
+
+  bool have_left = face_loaded(left);
+  bool have_right = face_loaded(right);
+  if (have_left) {
+    rle_stream_begin(left, &face_strips[0]);
+  }
+  if (have_right) {
+    rle_stream_begin(right, &face_strips[1]);
+  }
+
+  for (int y0 = 0; y0 < y1; y0 += RLE_STREAM_BAND_ROWS) {
+    layers->left = have_left ? rle_stream_next_band(left) : NULL;
+    layers->right = have_right ? rle_stream_next_band(right) : NULL;
+    layers->face_y0 = y0;
+
+    GRect band = GRect(0, y0, SCREEN_WIDTH, RLE_STREAM_BAND_ROWS);
+    for (int i = 0; i < num_rects; ++i) {
+      GRect clip = rects[i];
+      grect_clip(&clip, &band);
+      if (!grect_is_empty(&clip)) {
+        draw_wipe(ctx, &clip, 1, layers);
+      }
+    }
+  }
+#else
+  layers->left = left->bitmap;
+  layers->right = right->bitmap;
+  layers->face_y0 = 0;
+  draw_wipe(ctx, rects, num_rects, layers);
+#endif  // FACE_STREAMING
+}
+
+// Notes that the minutes card has just been drawn afresh, without
+// the minutes or the colon.
+void card_erased() {
+  drawn_digits[0] = -1;
+  drawn_digits[1] = -1;
+  drawn_colon = false;
 }
 
 void face_layer_update_callback(Layer *me, GContext* ctx) {
+  PERF_BEGIN(start);
+  uint32_t render_start_ms = clock_now_ms();
+  int transition_ms = num_transition_frames * ANIM_TICK_MS;
+  int elapsed_ms = 0;
   int ti = 0;
-  
+
   if (face_transition) {
-    // ti ranges from 0 to num_transition_frames over the transition.
-    ti = transition_frame;
-    transition_frame++;
+    // The transition's progress is measured by the clock, not by the
+    // number of frames we have drawn: if we fall behind, frames are
+    // dropped, and redraws triggered by other layers don't hurry it
+    // along.  ti, the nominal frame number, ranges from 0 to
+    // num_transition_frames over the transition.
+    elapsed_ms = get_transition_elapsed_ms();
+    ti = elapsed_ms / ANIM_TICK_MS;
     if (ti > num_transition_frames) {
       stop_transition();
     }
+    if (elapsed_ms > transition_ms) {
+      elapsed_ms = transition_ms;
+    }
   }
 
   if (!face_transition) {
     // The simple case: no transition, so just hold the current frame.
-    if (face_value >= 0 && face_image.bitmap != NULL) {
-      GRect destination = layer_get_frame(me);
-      destination.origin.x = 0;
-      destination.origin.y = 0;
-      
+    if (face_value >= 0 && face_loaded(&face_image)) {
       graphics_context_set_compositing_mode(ctx, GCompOpAssign);
-      graphics_draw_bitmap_in_rect(ctx, face_image.bitmap, destination);
+      if (!card_drawn) {
+        GRect screen = SCREEN_RECT;
+        draw_face(ctx, &face_image, SCREEN_RECT, &screen, 1);
+        card_erased();
+        card_drawn = true;
+      } else {
+        // Draw all but the minutes card, which still holds the face
+        // and whatever the minutes and colon layers drew over it.
+        GRect card = MINS_CARD_RECT;
+        GRect clips[2];
+        clips[0] = GRect(0, 0, SCREEN_WIDTH, card.origin.y);
+        clips[1] = GRect(0, card.origin.y, card.origin.x, card.size.h);
+        draw_face(ctx, &face_image, SCREEN_RECT, clips, 2);
+      }
     }
 
   } else {
@@ -652,151 +1007,196 @@ void face_layer_update_callback(Layer *me, GContext* ctx) {
     // Compute the current pixel position of the center of the wipe.
     // It might be offscreen on one side or the other.
     int wipe_x;
-    wipe_x = wipe_width - ti * wipe_width / num_transition_frames;
+    wipe_x = wipe_width - elapsed_ms * wipe_width / transition_ms;
     if (wipe_direction) {
       wipe_x = wipe_width - wipe_x;
     }
     wipe_x = wipe_x - (sprite_width - sprite_cx);
 
-    GRect destination = layer_get_frame(me);
-    destination.origin.x = 0;
-    destination.origin.y = 0;
-
-#ifdef FB_HACK
+#ifdef FB_SNAPSHOT
     if (fb_image.bitmap != NULL && prev_image.bitmap == NULL) {
       prev_image = fb_image;
       fb_image.bitmap = NULL;
       fb_image.data = NULL;
     }
-#endif  // FB_HACK
-    
-    if (wipe_direction) {
-      // First, draw the previous face.
-      if (wipe_x < SCREEN_WIDTH) {
-        if (prev_image.bitmap != NULL) {
-          graphics_context_set_compositing_mode(ctx, GCompOpAssign);
-          graphics_draw_bitmap_in_rect(ctx, prev_image.bitmap, destination);
-        } else {
-          graphics_context_set_fill_color(ctx, GColorBlack);
-          graphics_fill_rect(ctx, destination, 0, GCornerNone);
-        }
+#endif  // FB_SNAPSHOT
+
+    // The sprite is centered vertically on the wipe line.
+    GRect sprite_box;
+    sprite_box.size.w = sprite_mask.bitmap->bounds.size.w;
+    sprite_box.size.h = sprite_mask.bitmap->bounds.size.h;
+    sprite_box.origin.y = (SCREEN_HEIGHT - sprite_box.size.h) / 2;
+    sprite_box.origin.x = wipe_x - sprite_cx;
+
+    GBitmap *sprite_image = sprite.bitmap;
+    if (sprite_atlas.num_frames > 1) {
+      // Tardis case.  It's animated, so we draw the current frame,
+      // which was decoded into the arena at the start of the
+      // transition (or, if mirrored, the last time it was drawn), so
+      // as not to decode it again with every frame of the animation.
+      int af = ti % sprite_atlas.num_frames;
+      if (anim_direction) {
+        af = (sprite_atlas.num_frames - 1) - af;
       }
-      
-      if (wipe_x > 0) {
-        // Then, draw the new face on top of it, reducing the size to wipe
-        // from right to left.
-        if (face_image.bitmap != NULL) {
-          destination.size.w = wipe_x;
-          graphics_draw_bitmap_in_rect(ctx, face_image.bitmap, destination);
-        }
-      }
-    } else {
-      // First, draw the new face.
-      if (wipe_x < SCREEN_WIDTH) {
-        if (face_image.bitmap != NULL) {
-          graphics_context_set_compositing_mode(ctx, GCompOpAssign);
-          graphics_draw_bitmap_in_rect(ctx, face_image.bitmap, destination);
-        }
-      }
-      
-      if (wipe_x > 0) {
-        // Then, draw the previous face on top of it, reducing the size to wipe
-        // from right to left.
-        destination.size.w = wipe_x;
-        if (prev_image.bitmap != NULL) {
-          graphics_draw_bitmap_in_rect(ctx, prev_image.bitmap, destination);
-        } else {
-          graphics_context_set_fill_color(ctx, GColorBlack);
-          graphics_fill_rect(ctx, destination, 0, GCornerNone);
-        }
+      if (static_sprite) {
+        af = 0;
       }
+      sprite_image = tardis_frame(af);
     }
 
-    if (sprite_mask.bitmap != NULL) {
-      // Then, draw the sprite on top of the wipe line.
-      destination.size.w = sprite_mask.bitmap->bounds.size.w;
-      destination.size.h = sprite_mask.bitmap->bounds.size.h;
-      destination.origin.y = (SCREEN_HEIGHT - destination.size.h) / 2;
-      destination.origin.x = wipe_x - sprite_cx;
-      graphics_context_set_compositing_mode(ctx, GCompOpClear);
-      graphics_draw_bitmap_in_rect(ctx, sprite_mask.bitmap, destination);
-
-      if (sprite.bitmap != NULL) {
-        // Fixed sprite case.
-        graphics_context_set_compositing_mode(ctx, GCompOpOr);
-        graphics_draw_bitmap_in_rect(ctx, sprite.bitmap, destination);
-      } else {
-        // Tardis case.  Since it's animated, but we don't have enough
-        // RAM to hold all the frames at once, we have to load one
-        // frame at a time as we need it.  We don't use RLE encoding
-        // on the Tardis frames in an attempt to cut down on needless
-        // CPU work while playing this animation.
-        int af = ti % NUM_TARDIS_FRAMES;
-        if (anim_direction) {
-          af = (NUM_TARDIS_FRAMES - 1) - af;
-        }
-        GBitmap *tardis = gbitmap_create_with_resource(tardis_frames[af].tardis);
-        if (tardis != NULL) {
-          if (tardis_frames[af].flip_x) {
-            flip_bitmap_x(tardis);
-          }
-          
-          graphics_context_set_compositing_mode(ctx, GCompOpOr);
-          graphics_draw_bitmap_in_rect(ctx, tardis, destination);
-          
-          gbitmap_destroy(tardis);
-        }
-      }
-      
-      // Finally, re-draw the minutes background card on top of the sprite.
-      destination.size.w = 50;
-      destination.size.h = 31;
-      destination.origin.x = SCREEN_WIDTH - destination.size.w;
-      destination.origin.y = SCREEN_HEIGHT - destination.size.h;
-      graphics_context_set_compositing_mode(ctx, GCompOpOr);
-      graphics_draw_bitmap_in_rect(ctx, mins_background.bitmap, destination);
+    // The new face wipes in from the right when wipe_direction is
+    // true, so it is on the left of the wipe line; otherwise it's the
+    // previous face that remains on the left.
+    Face *left = wipe_direction ? &face_image : &prev_image;
+    Face *right = wipe_direction ? &prev_image : &face_image;
+    WipeLayers layers;
+    layers.wipe_x = wipe_x;
+    layers.sprite_mask = sprite_mask.bitmap;
+    layers.sprite = sprite_image;
+    layers.sprite_box = sprite_box;
+    layers.card = mins_background.bitmap;
+    layers.card_box = MINS_CARD_RECT;
+
+    if (!wipe_drawn) {
+      // The framebuffer doesn't hold the previous frame of this wipe,
+      // so draw the whole thing.
+      GRect screen = SCREEN_RECT;
+      draw_wipe_faces(ctx, &screen, 1, &layers, left, right);
+    } else {
+      // Only redraw what has changed since the last frame: the strip
+      // the wipe line has crossed, and wherever the sprite was or now
+      // is.  We also redraw the minutes card, since the minutes and
+      // the colon are drawn on top of it, and they may have changed.
+      int x0 = (last_wipe_x < wipe_x) ? last_wipe_x : wipe_x;
+      int x1 = (last_wipe_x < wipe_x) ? wipe_x : last_wipe_x;
+      GRect damage[3];
+      damage[0] = GRect(x0, 0, x1 - x0, SCREEN_HEIGHT);
+      damage[1] = grect_union(last_sprite_box, sprite_box);
+      damage[2] = MINS_CARD_RECT;
+      draw_wipe_faces(ctx, damage, 3, &layers, left, right);
     }
+
+    wipe_drawn = true;
+    last_wipe_x = wipe_x;
+    last_sprite_box = sprite_box;
+
+    // We've redrawn the card, without the minutes.
+    card_erased();
+    card_drawn = false;
+
+    // Now is when the heap is fullest: both faces, the sprite and its
+    // mask, or the Tardis frames.
+    HEAP_SAMPLE(HEAP_AT_FRAME);
+
+    govern_frame_rate((int)(clock_now_ms() - render_start_ms));
   }
+  PERF_END(PERF_FACE_UPDATE, start);
 }
   
+// Draws the glyph into the indicated cell of the minutes card, in the
+// coordinates of the layer.  If erase is true, the cell is first
+// restored from the face, to remove whatever glyph was there before;
+// the glyph may be NULL to just erase.
+void draw_card_glyph(GContext *ctx, Layer *layer, GBitmap *glyph, GRect cell, bool erase) {
+  if (erase) {
+    GRect frame = layer_get_frame(layer);
+    if (face_loaded(&face_image)) {
+      graphics_context_set_compositing_mode(ctx, GCompOpAssign);
+      draw_face(ctx, &face_image, GRect(-frame.origin.x, -frame.origin.y, SCREEN_WIDTH, SCREEN_HEIGHT), &cell, 1);
+    } else {
+      graphics_context_set_fill_color(ctx, GColorWhite);
+      graphics_fill_rect(ctx, cell, 0, GCornerNone);
+    }
+  }
+
+  if (glyph != NULL) {
+    // The glyphs are black on white, so we And them onto the card.
+    graphics_context_set_compositing_mode(ctx, GCompOpAnd);
+    graphics_draw_bitmap_in_rect(ctx, glyph, cell);
+  }
+}
+
+#ifdef MINUTE_GLYPHS
+
 void minute_layer_update_callback(Layer *me, GContext* ctx) {
-  GFont font;
-  GRect box;
-  static const int buffer_size = 128;
-  char buffer[buffer_size];
+  int digits[2];
+  digits[0] = minute_value / 10;
+  digits[1] = minute_value % 10;
+
+  // Only redraw the digits that aren't already on the card.
+  for (int i = 0; i < 2; ++i) {
+    if (digits[i] != drawn_digits[i]) {
+      draw_card_glyph(ctx, me, digit_glyphs[digits[i]].bitmap, DIGIT_RECT(i), drawn_digits[i] != -1);
+      drawn_digits[i] = digits[i];
+    }
+  }
+}
 
-  font = fonts_get_system_font(FONT_KEY_BITHAM_30_BLACK);
+void second_layer_update_callback(Layer *me, GContext* ctx) {
+  bool show_colon = !colon_blinks() || !hide_colon;
+  if (show_colon != drawn_colon) {
+    if (show_colon) {
+      draw_card_glyph(ctx, me, colon_glyph.bitmap, COLON_RECT, false);
+    } else {
+      draw_card_glyph(ctx, me, NULL, COLON_RECT, true);
+    }
+    drawn_colon = show_colon;
+  }
+}
 
-  box = layer_get_frame(me);
-  box.origin.x = 0;
-  box.origin.y = 0;
+#else
 
-  graphics_context_set_text_color(ctx, GColorBlack);
+// Draws the minutes, then the colon if it's on the card, as text in
+// Bitham 30 Black, in the coordinates of either layer (they share an
+// origin).  The text engine lays out " %02d" as a whole, and we don't
+// know just where its glyphs fall, so the minutes are always drawn
+// together, and whatever is erased is drawn again in full, clipped to
+// the layer.
+void draw_card_text(GContext *ctx) {
+  GFont font = fonts_get_system_font(FONT_KEY_BITHAM_30_BLACK);
+  GRect minute_box = MINUTE_LAYER_RECT;
+  GRect second_box = SECOND_LAYER_RECT;
+  char buffer[8];
 
-  snprintf(buffer, buffer_size, " %02d", minute_value);
-  graphics_draw_text(ctx, buffer, font, box,
+  graphics_context_set_text_color(ctx, GColorBlack);
+  snprintf(buffer, sizeof(buffer), " %02d", minute_value);
+  graphics_draw_text(ctx, buffer, font, GRect(0, 0, minute_box.size.w, minute_box.size.h),
                      GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft,
                      NULL);
-}
-  
-void second_layer_update_callback(Layer *me, GContext* ctx) {
-  if (!config.second_hand || !hide_colon) {
-    GFont font;
-    GRect box;
-  
-    font = fonts_get_system_font(FONT_KEY_BITHAM_30_BLACK);
-    
-    box = layer_get_frame(me);
-    box.origin.x = 0;
-    box.origin.y = 0;
-    
-    graphics_context_set_text_color(ctx, GColorBlack);
-    graphics_draw_text(ctx, ":", font, box,
+  if (drawn_colon) {
+    graphics_draw_text(ctx, ":", font, GRect(0, 0, second_box.size.w, second_box.size.h),
                        GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft,
                        NULL);
   }
 }
 
+void minute_layer_update_callback(Layer *me, GContext* ctx) {
+  int digits[2];
+  digits[0] = minute_value / 10;
+  digits[1] = minute_value % 10;
+
+  if (digits[0] != drawn_digits[0] || digits[1] != drawn_digits[1]) {
+    // Erase the old minutes, and the colon with them, if they were
+    // there, and draw both again.
+    draw_card_glyph(ctx, me, NULL, layer_get_bounds(me), drawn_digits[0] != -1);
+    drawn_digits[0] = digits[0];
+    drawn_digits[1] = digits[1];
+    draw_card_text(ctx);
+  }
+}
+
+void second_layer_update_callback(Layer *me, GContext* ctx) {
+  bool show_colon = !colon_blinks() || !hide_colon;
+  if (show_colon != drawn_colon) {
+    // Erasing the colon may take the edge of the minutes with it,
+    // so those are drawn again too.
+    draw_card_glyph(ctx, me, NULL, layer_get_bounds(me), drawn_colon);
+    drawn_colon = show_colon;
+    draw_card_text(ctx);
+  }
+}
+
+#endif  // MINUTE_GLYPHS
 
 // Update the watch as time passes.
 void handle_tick(struct tm *tick_time, TimeUnits units_changed) {
@@ -807,21 +1207,9 @@ void handle_tick(struct tm *tick_time, TimeUnits units_changed) {
 
   int face_new, minute_new, second_new;
 
-  face_new = tick_time->tm_hour % 12;
+  face_new = face_for_time(tick_time);
   minute_new = tick_time->tm_min;
   second_new = tick_time->tm_sec;
-  if (config.hurt && face_new == 8 && minute_new >= 30) {
-    // Face 8.5 is John Hurt.
-    face_new = 12;
-  }
-#ifdef FAST_TIME
-  if (config.hurt) {
-    face_new = ((tick_time->tm_min * 60 + tick_time->tm_sec) / 5) % 13;
-  } else {
-    face_new = ((tick_time->tm_min * 60 + tick_time->tm_sec) / 5) % 12;
-  }
-  minute_new = tick_time->tm_sec;
-#endif
 
   if (minute_new != minute_value) {
     // Update the minute display.
@@ -833,16 +1221,11 @@ void handle_tick(struct tm *tick_time, TimeUnits units_changed) {
     // Update the second display.
     second_value = second_new;
     hide_colon = false;
-    if (config.second_hand) {
+    if (colon_blinks()) {
       // To blink the colon once per second, draw it now, then make it
       // go away after a half-second.
       layer_mark_dirty(second_layer);
-
-      if (blink_timer != NULL) {
-        app_timer_cancel(blink_timer);
-	blink_timer = NULL;
-      }
-      blink_timer = app_timer_register(500, &handle_blink, 0);
+      scheduler_set(EVENT_BLINK, 500, &handle_blink);
     }
   }
 
@@ -852,28 +1235,61 @@ void handle_tick(struct tm *tick_time, TimeUnits units_changed) {
     start_transition(face_new, false);
   }
 
-  set_next_timer();
+  check_prefetch_heap();
 }
 
-// Updates any runtime settings as needed when the config changes.
-void apply_config() {
-  app_log(APP_LOG_LEVEL_INFO, __FILE__, __LINE__, "apply_config, second_hand=%d", config.second_hand);
+// Called when the window comes (back) onscreen.  Whatever was on the
+// screen before may have overwritten the framebuffer, so the next
+// frame must be drawn in full.
+void handle_window_appear(Window *window) {
+  card_drawn = false;
+  wipe_drawn = false;
+}
+
+// Subscribes to the tick service, at once per second if we need to
+// blink the colon, or once per minute otherwise.
+void subscribe_tick() {
   tick_timer_service_unsubscribe();
 
-#ifdef FAST_TIME
-  tick_timer_service_subscribe(SECOND_UNIT, handle_tick);
-#else
-  if (config.second_hand) {
+  if (colon_blinks()) {
     tick_timer_service_subscribe(SECOND_UNIT, handle_tick);
   } else {
     tick_timer_service_subscribe(MINUTE_UNIT, handle_tick);
   }
-#endif
+}
+
+// Updates any runtime settings as needed when the config changes.
+void apply_config() {
+  app_log(APP_LOG_LEVEL_INFO, __FILE__, __LINE__, "apply_config, second_hand=%d", config.second_hand);
+
+  // The prefetched face may no longer be the right one.
+  drop_prefetch();
+
+  low_power = battery_low_power();
+  subscribe_tick();
 
   refresh_battery_gauge();
   refresh_bluetooth_indicator();
 }
 
+// Called by the battery gauge whenever the battery state changes, to
+// enter or leave low-power mode as appropriate.
+void apply_power_mode() {
+  bool new_low_power = battery_low_power();
+  if (new_low_power != low_power) {
+    app_log(APP_LOG_LEVEL_INFO, __FILE__, __LINE__, "apply_power_mode, low_power=%d", new_low_power);
+    low_power = new_low_power;
+    subscribe_tick();
+
+    // A prefetched Tardis was decoded for the other mode.
+    drop_prefetch();
+
+    // Leave the colon showing, whether we're going to blink it or not.
+    hide_colon = false;
+    layer_mark_dirty(second_layer);
+  }
+}
+
 void handle_init() {
   load_config();
 
@@ -892,6 +1308,9 @@ void handle_init() {
   hide_colon = false;
   
   window = window_create();
+  window_set_window_handlers(window, (WindowHandlers) {
+    .appear = &handle_window_appear,
+  });
   // GColorClear doesn't seem to work: it is the same as GColorWhite in this context.
   window_set_background_color(window, GColorClear);
   struct Layer *root_layer = window_get_root_layer(window);
@@ -903,45 +1322,161 @@ void handle_init() {
   // anyway.  So whatever.
   window_stack_push(window, true);
 
+  if (!arena_init(arena_slot_sizes, NUM_ARENA_SLOTS)) {
+    app_log(APP_LOG_LEVEL_WARNING, __FILE__, __LINE__, "bitmap arena unavailable; using the heap");
+  }
+
   mins_background = rle_bwd_create(RESOURCE_ID_MINS_BACKGROUND);
   assert(mins_background.bitmap != NULL);
 
+#ifdef FACE_STREAMING
+  for (int i = 0; i < 2; ++i) {
+    bool strip_ok = rle_strip_init(&face_strips[i], ((SCREEN_WIDTH + 31) / 32) * 4);
+    assert(strip_ok);
+  }
+#endif  // FACE_STREAMING
+
+#ifdef MINUTE_GLYPHS
+  for (int i = 0; i < 10; ++i) {
+    digit_glyphs[i] = rle_bwd_create(digit_resource_ids[i]);
+  }
+  colon_glyph = rle_bwd_create(RESOURCE_ID_COLON);
+#endif  // MINUTE_GLYPHS
+  card_erased();
+
   face_layer = layer_create(layer_get_bounds(root_layer));
   layer_set_update_proc(face_layer, &face_layer_update_callback);
   layer_add_child(root_layer, face_layer);
 
-  minute_layer = layer_create(GRect(95, 134, 62, 35));
+  minute_layer = layer_create(MINUTE_LAYER_RECT);
   layer_set_update_proc(minute_layer, &minute_layer_update_callback);
   layer_add_child(root_layer, minute_layer);
 
-  second_layer = layer_create(GRect(95, 134, 16, 35));
+  second_layer = layer_create(SECOND_LAYER_RECT);
   layer_set_update_proc(second_layer, &second_layer_update_callback);
   layer_add_child(root_layer, second_layer);
 
   init_battery_gauge(root_layer, 125, 0, false, true);
   init_bluetooth_indicator(root_layer, 0, 0, false, true);
 
+  // Whatever heap is left over can go to the Tardis.  From here on,
+  // the transitions (and the startup wipe's snapshot) take only arena
+  // slots, so there's no need to wait until after the first one.
+  int added = arena_add_slots(SPRITE_BYTES, TARDIS_EXTRA_SLOTS, TARDIS_SLOTS_HEAP_RESERVE);
+  if (added < TARDIS_EXTRA_SLOTS) {
+    app_log(APP_LOG_LEVEL_INFO, __FILE__, __LINE__, "room for %d of %d tardis frame slots", added, TARDIS_EXTRA_SLOTS);
+  }
+
   start_transition(startup_time->tm_hour % 12, true);
 
   apply_config();
+
+  handle_buzzer();
+  handle_prefetch();
 }
 
 void handle_deinit() {
   tick_timer_service_unsubscribe();
   stop_transition();
+  drop_prefetch();
+  scheduler_deinit();
 
   window_stack_pop_all(false);  // Not sure if this is needed?
   layer_destroy(minute_layer);
   layer_destroy(face_layer);
   window_destroy(window);
 
-  bwd_destroy(&face_image);
+  face_destroy(&face_image);
+#ifdef FACE_STREAMING
+  for (int i = 0; i < 2; ++i) {
+    rle_strip_deinit(&face_strips[i]);
+  }
+#endif  // FACE_STREAMING
   bwd_destroy(&mins_background);
+#ifdef MINUTE_GLYPHS
+  for (int i = 0; i < 10; ++i) {
+    bwd_destroy(&digit_glyphs[i]);
+  }
+  bwd_destroy(&colon_glyph);
+#endif  // MINUTE_GLYPHS
+  arena_deinit();
+}
+
+#ifdef GLYPH_CAPTURE
+
+// Logs the indicated cell of the framebuffer, one line per row, with
+// a '#' for each black pixel and a '.' for each white one.
+void log_glyph_cell(GBitmap *fb, const char *name, GRect cell) {
+  char row_text[32];
+  assert(cell.size.w < (int)sizeof(row_text));
+  for (int y = 0; y < cell.size.h; ++y) {
+    const uint8_t *row = (const uint8_t *)fb->addr + (cell.origin.y + y) * fb->row_size_bytes;
+    for (int x = 0; x < cell.size.w; ++x) {
+      int fx = cell.origin.x + x;
+      row_text[x] = ((row[fx / 8] >> (fx % 8)) & 1) ? '.' : '#';
+    }
+    row_text[cell.size.w] = '\0';
+    app_log(APP_LOG_LEVEL_INFO, __FILE__, __LINE__, "glyph %s %d %s", name, y, row_text);
+  }
+}
+
+// Draws each glyph on white, with the text the minutes or colon layer
+// would have drawn for it, and logs its cell.  A digit is drawn as
+// the minutes layer drew minute dd, and taken from the first cell.
+void glyph_capture_update_callback(Layer *me, GContext *ctx) {
+  GFont font = fonts_get_system_font(FONT_KEY_BITHAM_30_BLACK);
+  GRect minute_box = MINUTE_LAYER_RECT;
+  GRect second_box = SECOND_LAYER_RECT;
+
+  for (int g = 0; g <= 10; ++g) {
+    char text[8];
+    char name[16];
+    GRect box = (g < 10) ? minute_box : second_box;
+    GRect cell = (g < 10) ? DIGIT_RECT(0) : COLON_RECT;
+    if (g < 10) {
+      snprintf(text, sizeof(text), " %d%d", g, g);
+      snprintf(name, sizeof(name), "digit_%d", g);
+    } else {
+      snprintf(text, sizeof(text), ":");
+      snprintf(name, sizeof(name), "colon");
+    }
+    cell.origin.x += box.origin.x;
+    cell.origin.y += box.origin.y;
+
+    graphics_context_set_fill_color(ctx, GColorWhite);
+    graphics_fill_rect(ctx, SCREEN_RECT, 0, GCornerNone);
+    graphics_context_set_text_color(ctx, GColorBlack);
+    graphics_draw_text(ctx, text, font, box,
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft,
+                       NULL);
+
+    GBitmap *fb = graphics_capture_frame_buffer(ctx);
+    assert(fb != NULL);
+    log_glyph_cell(fb, name, cell);
+    graphics_release_frame_buffer(ctx, fb);
+  }
+  app_log(APP_LOG_LEVEL_INFO, __FILE__, __LINE__, "glyph capture done");
 }
 
+int main(void) {
+  window = window_create();
+  Layer *capture_layer = layer_create(SCREEN_RECT);
+  layer_set_update_proc(capture_layer, &glyph_capture_update_callback);
+  layer_add_child(window_get_root_layer(window), capture_layer);
+  window_stack_push(window, false);
+
+  app_event_loop();
+  layer_destroy(capture_layer);
+  window_destroy(window);
+}
+
+#else
+
 int main(void) {
   handle_init();
 
   app_event_loop();
   handle_deinit();
 }
+
+#endif  // GLYPH_CAPTURE
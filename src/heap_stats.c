@@ -0,0 +1,118 @@
+#include <pebble.h>
+#include "heap_stats.h"
+#include "assert.h"
+
+static const char *heap_sprite_names[HEAP_STATS_MAX_SPRITES] = {
+  "tardis",
+  "k9",
+  "dalek",
+};
+
+#ifdef HEAP_STATS_FAIL_LOUD
+static const char *heap_point_names[NUM_HEAP_POINTS] = {
+  "start",
+  "frame",
+  "stop",
+};
+#endif  // HEAP_STATS_FAIL_LOUD
+
+// The totals for each sprite, over the life of the app.
+static HeapStat heap_stats[HEAP_STATS_MAX_SPRITES];
+
+// The sprite of the current transition, and the samples taken during
+// it.
+static int heap_sprite = -1;
+static size_t heap_used_at[NUM_HEAP_POINTS];
+static size_t heap_max_used;
+static size_t heap_min_free;
+static uint16_t heap_num_frames;
+
+// Starts tracking a transition with the indicated sprite.
+void heap_stats_begin(int sprite) {
+  assert(sprite >= 0 && sprite < HEAP_STATS_MAX_SPRITES);
+  heap_sprite = sprite;
+  if (heap_stats[sprite].transitions++ == 0) {
+    heap_stats[sprite].min_free = (size_t)-1;
+  }
+  memset(heap_used_at, 0, sizeof(heap_used_at));
+  heap_max_used = 0;
+  heap_min_free = (size_t)-1;
+  heap_num_frames = 0;
+  heap_stats_sample(HEAP_AT_START);
+}
+
+void heap_stats_sample(HeapPoint point) {
+  if (heap_sprite < 0) {
+    return;
+  }
+  HeapStat *stat = &heap_stats[heap_sprite];
+  size_t used = heap_bytes_used();
+  size_t free_bytes = heap_bytes_free();
+
+  heap_used_at[point] = used;
+  if (point == HEAP_AT_FRAME) {
+    heap_num_frames++;
+  }
+  if (used > heap_max_used) {
+    heap_max_used = used;
+  }
+  if (free_bytes < heap_min_free) {
+    heap_min_free = free_bytes;
+  }
+  if (used > stat->max_used) {
+    stat->max_used = used;
+  }
+  if (free_bytes < stat->min_free) {
+    stat->min_free = free_bytes;
+  }
+
+  if (free_bytes < HEAP_BUDGET_MIN_FREE) {
+    stat->over_budget++;
+#ifdef HEAP_STATS_FAIL_LOUD
+    app_log(APP_LOG_LEVEL_ERROR, __FILE__, __LINE__, "heap over budget at %s of %s: used=%d free=%d",
+            heap_point_names[point], heap_sprite_names[heap_sprite], (int)used, (int)free_bytes);
+    assert(free_bytes >= HEAP_BUDGET_MIN_FREE);
+#endif  // HEAP_STATS_FAIL_LOUD
+  }
+}
+
+// Records that an allocation for the indicated sprite's transition
+// returned NULL.  This may be while the transition is being
+// prefetched, before heap_stats_begin().
+void heap_stats_failure(int sprite, const char *what) {
+  assert(sprite >= 0 && sprite < HEAP_STATS_MAX_SPRITES);
+  heap_stats[sprite].failures++;
+  app_log(APP_LOG_LEVEL_WARNING, __FILE__, __LINE__, "%s: couldn't allocate %s, free=%d",
+          heap_sprite_names[sprite], what, (int)heap_bytes_free());
+#ifdef HEAP_STATS_FAIL_LOUD
+  assert(false);
+#endif  // HEAP_STATS_FAIL_LOUD
+}
+
+// Returns the number of allocation failures so far, for every sprite.
+int heap_stats_num_failures() {
+  int failures = 0;
+  for (int i = 0; i < HEAP_STATS_MAX_SPRITES; ++i) {
+    failures += heap_stats[i].failures;
+  }
+  return failures;
+}
+
+// Logs the samples of the transition just finished, and the totals
+// for its sprite so far.
+void heap_stats_log_summary() {
+  if (heap_sprite < 0) {
+    return;
+  }
+  HeapStat *stat = &heap_stats[heap_sprite];
+  app_log(APP_LOG_LEVEL_INFO, __FILE__, __LINE__,
+          "heap %s: used start=%d stop=%d max=%d, min free=%d over %d frames",
+          heap_sprite_names[heap_sprite], (int)heap_used_at[HEAP_AT_START],
+          (int)heap_used_at[HEAP_AT_STOP], (int)heap_max_used, (int)heap_min_free,
+          heap_num_frames);
+  app_log(APP_LOG_LEVEL_INFO, __FILE__, __LINE__,
+          "heap %s: n=%d max used=%d min free=%d failures=%d over budget=%d",
+          heap_sprite_names[heap_sprite], stat->transitions, (int)stat->max_used,
+          (int)stat->min_free, stat->failures, stat->over_budget);
+  heap_sprite = -1;
+}
@@ -0,0 +1,57 @@
+#ifndef HEAP_STATS_H
+#define HEAP_STATS_H
+
+#include <pebble.h>
+
+// Define this to sample heap_bytes_free() and heap_bytes_used() at
+// the start of every transition, at each of its frames, and at its
+// end, and log the high-water marks and any allocation failures for
+// each sprite when it stops.
+//#define HEAP_STATS 1
+
+// Define this as well to crash, via assert(), as soon as a sample
+// finds less than HEAP_BUDGET_MIN_FREE bytes free, or a transition
+// fails to allocate something it wanted.  Useful during development
+// to catch a transition that has crept over budget.
+//#define HEAP_STATS_FAIL_LOUD 1
+
+// The least amount of heap, in bytes, that should remain free at any
+// point during a transition.
+#define HEAP_BUDGET_MIN_FREE 2048
+
+// One for each of the SPRITE_* values in doctors.c.
+#define HEAP_STATS_MAX_SPRITES 3
+
+// The points at which we sample the heap.
+typedef enum {
+  HEAP_AT_START,  // The end of start_transition(), with everything loaded.
+  HEAP_AT_FRAME,  // Each frame, while its Tardis frame (if any) is loaded.
+  HEAP_AT_STOP,   // stop_transition(), before anything is released.
+  NUM_HEAP_POINTS
+} HeapPoint;
+
+typedef struct {
+  uint16_t transitions;
+  uint16_t failures;      // Allocations that returned NULL.
+  uint16_t over_budget;   // Samples with less than HEAP_BUDGET_MIN_FREE free.
+  size_t max_used;        // The high-water mark of heap_bytes_used().
+  size_t min_free;        // The low-water mark of heap_bytes_free().
+} HeapStat;
+
+void heap_stats_begin(int sprite);
+void heap_stats_sample(HeapPoint point);
+void heap_stats_failure(int sprite, const char *what);
+int heap_stats_num_failures();
+void heap_stats_log_summary();
+
+#ifdef HEAP_STATS
+#define HEAP_BEGIN(sprite) heap_stats_begin(sprite)
+#define HEAP_SAMPLE(point) heap_stats_sample(point)
+#define HEAP_FAILURE(sprite, what) heap_stats_failure(sprite, what)
+#else
+#define HEAP_BEGIN(sprite)
+#define HEAP_SAMPLE(point)
+#define HEAP_FAILURE(sprite, what)
+#endif  // HEAP_STATS
+
+#endif  // HEAP_STATS_H
@@ -6,6 +6,7 @@ var default_keep_bluetooth_indicator = 0;
 var default_second_hand = 0;
 var default_hour_buzzer = 0;
 var default_hurt = 1;
+var default_low_power = 0;
 
 var keep_battery_gauge = localStorage.getItem("doctors:keep_battery_gauge");
 if (!keep_battery_gauge) {
@@ -37,6 +38,12 @@ if (!hurt) {
 }
 hurt = parseInt(hurt);
 
+var low_power = localStorage.getItem("doctors:low_power");
+if (!low_power) {
+    low_power = default_low_power;
+}
+low_power = parseInt(low_power);
+
 Pebble.addEventListener("ready", function() {
     console.log("ready");
     console.log("   keep_battery_gauge: " + keep_battery_gauge);
@@ -44,6 +51,7 @@ Pebble.addEventListener("ready", function() {
     console.log("   second_hand: " + second_hand);
     console.log("   hour_buzzer: " + hour_buzzer);
     console.log("   hurt: " + hurt);
+    console.log("   low_power: " + low_power);
 
 	// At startup, send the current configuration to the Pebble--the
 	// phone storage keeps the authoritative state.  We delay by 1
@@ -56,6 +64,7 @@ Pebble.addEventListener("ready", function() {
 			'second_hand' : second_hand,
 			'hour_buzzer' : hour_buzzer,
 			'hurt' : hurt,
+			'low_power' : low_power,
 		};
   	    console.log("sending init config: " + JSON.stringify(configuration));
 		Pebble.sendAppMessage(configuration);
@@ -65,7 +74,7 @@ Pebble.addEventListener("ready", function() {
 });
 
 Pebble.addEventListener("showConfiguration", function(e) {
-    var url = "http://www.ddrose.com/pebble/doctors_configure.html?keep_battery_gauge=" + keep_battery_gauge + "&keep_bluetooth_indicator=" + keep_bluetooth_indicator + "&second_hand=" + second_hand + "&hour_buzzer=" + hour_buzzer + "&hurt=" + hurt;
+    var url = "http://www.ddrose.com/pebble/doctors_configure.html?keep_battery_gauge=" + keep_battery_gauge + "&keep_bluetooth_indicator=" + keep_bluetooth_indicator + "&second_hand=" + second_hand + "&hour_buzzer=" + hour_buzzer + "&hurt=" + hurt + "&low_power=" + low_power;
     console.log("showConfiguration: " + url);
     var result = Pebble.openURL(url);
     console.log("openURL result: " + result);
@@ -94,4 +103,7 @@ Pebble.addEventListener("webviewclosed", function(e) {
     
     hurt = configuration["hurt"];
     localStorage.setItem("doctors:hurt", hurt);
+    
+    low_power = configuration["low_power"];
+    localStorage.setItem("doctors:low_power", low_power);
 });
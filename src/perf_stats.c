@@ -0,0 +1,57 @@
+#include <pebble.h>
+#include "perf_stats.h"
+
+static const char *perf_path_names[NUM_PERF_PATHS] = {
+  "face_update",
+  "rle_decode",
+  "start_transition",
+};
+
+// The upper limit, in ms, of each histogram bucket but the last.
+static const uint16_t perf_bucket_limits[NUM_PERF_BUCKETS - 1] = {
+  5, 10, 20, 35, 50, 75, 100,
+};
+
+static PerfStat perf_stats[NUM_PERF_PATHS];
+
+void perf_record(PerfPath path, uint32_t elapsed_ms) {
+  PerfStat *stat = &perf_stats[path];
+  uint16_t ms = (elapsed_ms > 0xffff) ? 0xffff : elapsed_ms;
+  if (stat->count == 0 || ms < stat->min_ms) {
+    stat->min_ms = ms;
+  }
+  if (stat->count == 0 || ms > stat->max_ms) {
+    stat->max_ms = ms;
+  }
+  stat->count++;
+  stat->total_ms += ms;
+
+  int bucket = 0;
+  while (bucket < NUM_PERF_BUCKETS - 1 && ms >= perf_bucket_limits[bucket]) {
+    ++bucket;
+  }
+  stat->histogram[bucket]++;
+}
+
+// Logs one line for each path timed since the last summary, and then
+// starts over.
+void perf_log_summary() {
+  for (int path = 0; path < NUM_PERF_PATHS; ++path) {
+    PerfStat *stat = &perf_stats[path];
+    if (stat->count == 0) {
+      continue;
+    }
+
+    char histogram[64];
+    int len = 0;
+    for (int bucket = 0; bucket < NUM_PERF_BUCKETS; ++bucket) {
+      len += snprintf(histogram + len, sizeof(histogram) - len, "%s%d",
+                      bucket ? "/" : "", stat->histogram[bucket]);
+    }
+
+    app_log(APP_LOG_LEVEL_INFO, __FILE__, __LINE__, "%s: n=%d min=%d mean=%d max=%d ms, hist %s",
+            perf_path_names[path], (int)stat->count, stat->min_ms,
+            (int)(stat->total_ms / stat->count), stat->max_ms, histogram);
+  }
+  memset(perf_stats, 0, sizeof(perf_stats));
+}
@@ -0,0 +1,46 @@
+#ifndef PERF_STATS_H
+#define PERF_STATS_H
+
+#include <pebble.h>
+#include "clock_ms.h"
+
+// Define this to time the expensive paths of the watchface with
+// time_ms(), and log a summary of each path's timings at the end of
+// every transition.  This is included by each module that has code to
+// time, so it's defined here rather than in doctors.c.
+//#define PERF_STATS 1
+
+// The paths we time.
+typedef enum {
+  PERF_FACE_UPDATE,       // face_layer_update_callback()
+  PERF_RLE_DECODE,        // rle_bwd_create()
+  PERF_START_TRANSITION,  // start_transition()
+  NUM_PERF_PATHS
+} PerfPath;
+
+// The histogram buckets hold the number of samples of less than 5,
+// 10, 20, 35, 50, 75 and 100 ms, and the rest.  50 ms is ANIM_TICK_MS,
+// the frame budget.
+#define NUM_PERF_BUCKETS 8
+
+typedef struct {
+  uint32_t count;
+  uint32_t total_ms;
+  uint16_t min_ms;
+  uint16_t max_ms;
+  uint16_t histogram[NUM_PERF_BUCKETS];
+} PerfStat;
+
+void perf_record(PerfPath path, uint32_t elapsed_ms);
+void perf_log_summary();
+
+#ifdef PERF_STATS
+// Wrap the code to be timed in PERF_BEGIN(start) ... PERF_END(path, start).
+#define PERF_BEGIN(start) uint32_t start = clock_now_ms()
+#define PERF_END(path, start) perf_record(path, clock_now_ms() - (start))
+#else
+#define PERF_BEGIN(start)
+#define PERF_END(path, start)
+#endif  // PERF_STATS
+
+#endif  // PERF_STATS_H
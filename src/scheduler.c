@@ -0,0 +1,118 @@
+#include <pebble.h>
+#include "scheduler.h"
+#include "clock_ms.h"
+#include "assert.h"
+
+typedef struct {
+  SchedulerCallback callback;  // NULL if the event isn't pending.
+  uint32_t deadline_ms;
+} SchedulerEvent;
+
+static SchedulerEvent scheduler_events[SCHEDULER_MAX_EVENTS];
+
+static AppTimer *scheduler_timer = NULL;
+static uint32_t scheduler_timer_deadline_ms;  // When scheduler_timer fires.
+static bool scheduler_dispatching = false;
+
+static void scheduler_handle_timer(void *data);
+
+// Makes sure the timer is set for the earliest pending deadline, if
+// it isn't already.
+static void scheduler_arm() {
+  if (scheduler_dispatching) {
+    // We'll get to it when the dispatch is done.
+    return;
+  }
+
+  int earliest = -1;
+  for (int event = 0; event < SCHEDULER_MAX_EVENTS; ++event) {
+    SchedulerEvent *e = &scheduler_events[event];
+    if (e->callback != NULL &&
+        (earliest == -1 || (int32_t)(e->deadline_ms - scheduler_events[earliest].deadline_ms) < 0)) {
+      earliest = event;
+    }
+  }
+
+  if (earliest == -1) {
+    if (scheduler_timer != NULL) {
+      app_timer_cancel(scheduler_timer);
+      scheduler_timer = NULL;
+    }
+    return;
+  }
+
+  uint32_t deadline_ms = scheduler_events[earliest].deadline_ms;
+  if (scheduler_timer != NULL && scheduler_timer_deadline_ms == deadline_ms) {
+    // Already set.
+    return;
+  }
+
+  int32_t delay_ms = (int32_t)(deadline_ms - clock_now_ms());
+  if (delay_ms < 1) {
+    delay_ms = 1;
+  }
+  scheduler_timer_deadline_ms = deadline_ms;
+  if (scheduler_timer == NULL || !app_timer_reschedule(scheduler_timer, delay_ms)) {
+    scheduler_timer = app_timer_register(delay_ms, &scheduler_handle_timer, NULL);
+  }
+}
+
+// Calls back every event that is due, or nearly so, in order of
+// deadline.  Events set again by these callbacks wait for the next
+// time the timer fires, even if they are due already.
+static void scheduler_handle_timer(void *data) {
+  scheduler_timer = NULL;  // When the timer is handled, it is implicitly canceled.
+  scheduler_dispatching = true;
+
+  uint32_t now_ms = clock_now_ms();
+  SchedulerEvent due[SCHEDULER_MAX_EVENTS];
+  int num_due = 0;
+  for (int event = 0; event < SCHEDULER_MAX_EVENTS; ++event) {
+    SchedulerEvent *e = &scheduler_events[event];
+    if (e->callback != NULL && (int32_t)(e->deadline_ms - now_ms) <= SCHEDULER_COALESCE_MS) {
+      // Insertion sort by deadline.
+      int i = num_due++;
+      while (i > 0 && (int32_t)(e->deadline_ms - due[i - 1].deadline_ms) < 0) {
+        due[i] = due[i - 1];
+        --i;
+      }
+      due[i] = *e;
+      e->callback = NULL;
+    }
+  }
+
+  for (int i = 0; i < num_due; ++i) {
+    due[i].callback();
+  }
+
+  scheduler_dispatching = false;
+  scheduler_arm();
+}
+
+// Sets the event to call callback after delay_ms, replacing any
+// deadline it already had.
+void scheduler_set(int event, uint32_t delay_ms, SchedulerCallback callback) {
+  assert(event >= 0 && event < SCHEDULER_MAX_EVENTS && callback != NULL);
+  scheduler_events[event].callback = callback;
+  scheduler_events[event].deadline_ms = clock_now_ms() + delay_ms;
+  scheduler_arm();
+}
+
+void scheduler_cancel(int event) {
+  assert(event >= 0 && event < SCHEDULER_MAX_EVENTS);
+  scheduler_events[event].callback = NULL;
+  scheduler_arm();
+}
+
+bool scheduler_is_set(int event) {
+  assert(event >= 0 && event < SCHEDULER_MAX_EVENTS);
+  return scheduler_events[event].callback != NULL;
+}
+
+// Cancels all pending events.
+void scheduler_deinit() {
+  for (int event = 0; event < SCHEDULER_MAX_EVENTS; ++event) {
+    scheduler_events[event].callback = NULL;
+  }
+  scheduler_arm();
+}
@@ -0,0 +1,24 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <pebble.h>
+
+// A tiny deadline queue that multiplexes all of the app's timed events
+// onto a single AppTimer.  Each event is identified by a small integer
+// chosen by the caller, and has at most one pending deadline.
+
+#define SCHEDULER_MAX_EVENTS 4
+
+// Events whose deadlines fall within this many ms of the one that
+// fired the timer are dispatched along with it, rather than waking us
+// again a moment later.
+#define SCHEDULER_COALESCE_MS 20
+
+typedef void (*SchedulerCallback)(void);
+
+void scheduler_set(int event, uint32_t delay_ms, SchedulerCallback callback);
+void scheduler_cancel(int event);
+bool scheduler_is_set(int event);
+void scheduler_deinit();
+
+#endif  // SCHEDULER_H
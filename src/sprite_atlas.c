@@ -0,0 +1,57 @@
+#include <pebble.h>
+#include "sprite_atlas.h"
+#include "assert.h"
+#include "arena.h"
+
+// Reads the header and tables of the indicated atlas resource.  This
+// is all the atlas keeps in RAM; its images are decoded as they are
+// needed.
+void sprite_atlas_init(SpriteAtlas *atlas, int resource_id) {
+  uint8_t buffer[4 + 2 * ATLAS_MAX_IMAGES + 2 * (2 + ATLAS_MAX_FRAMES)];
+  ResHandle rh = resource_get_handle(resource_id);
+  size_t size = resource_load_byte_range(rh, 0, buffer, sizeof(buffer));
+  assert(size >= 4);
+
+  atlas->resource_id = resource_id;
+  atlas->num_images = buffer[0];
+  atlas->num_frames = buffer[1];
+  atlas->num_facings = buffer[2];
+  assert(atlas->num_images <= ATLAS_MAX_IMAGES && atlas->num_frames <= ATLAS_MAX_FRAMES &&
+         atlas->num_facings >= 1 && atlas->num_facings <= 2);
+
+  const uint8_t *p = buffer + 4;
+  for (int i = 0; i < atlas->num_images; ++i) {
+    atlas->offsets[i] = p[0] | (p[1] << 8);
+    p += 2;
+  }
+  for (int f = 0; f < atlas->num_facings; ++f) {
+    AtlasFacing *facing = &atlas->facings[f];
+    facing->cx = p[0];
+    facing->mask = p[1];
+    memcpy(facing->frames, p + 2, atlas->num_frames);
+    p += 2 + atlas->num_frames;
+  }
+  assert((size_t)(p - buffer) <= size);
+}
+
+// Returns the facing to draw: the pre-mirrored copy if mirrored is
+// true and the atlas has one, or else the sprite as it was drawn.
+const AtlasFacing *sprite_atlas_facing(const SpriteAtlas *atlas, bool mirrored) {
+  return &atlas->facings[(mirrored && atlas->num_facings > 1) ? 1 : 0];
+}
+
+// Decodes the indicated image of the atlas onto the heap.  Release it
+// with bwd_destroy().  Returns a NULL bitmap if there isn't enough
+// memory.
+BitmapWithData sprite_atlas_bwd_create(const SpriteAtlas *atlas, int image) {
+  image &= ~ATLAS_FLIP_X;
+  assert(image < atlas->num_images);
+  return rle_bwd_create_offset(atlas->resource_id, atlas->offsets[image]);
+}
+
+// As above, but into a free slot of the bitmap arena if there is one.
+BitmapWithData sprite_atlas_arena_bwd_create(const SpriteAtlas *atlas, int image) {
+  image &= ~ATLAS_FLIP_X;
+  assert(image < atlas->num_images);
+  return arena_rle_bwd_create_offset(atlas->resource_id, atlas->offsets[image]);
+}
@@ -0,0 +1,40 @@
+#ifndef SPRITE_ATLAS_H
+#define SPRITE_ATLAS_H
+
+#include <pebble.h>
+#include "bwd.h"
+
+// All of one sprite's frames and masks, packed by make_rle.py -a into
+// a single resource, with a table of where each of its images begins
+// (see make_rle.py for the layout).  The atlas says how each frame is
+// drawn and where the sprite is centered, for each way it may face: as
+// it was drawn, and optionally as a pre-mirrored copy, for wipes in
+// the other direction.
+
+#define ATLAS_MAX_IMAGES 12
+#define ATLAS_MAX_FRAMES 8
+
+// Set in a frame's image to mirror the image as it is drawn.
+#define ATLAS_FLIP_X 0x80
+
+typedef struct {
+  int cx;                            // The horizontal center point.
+  int mask;                          // The image of the mask.
+  uint8_t frames[ATLAS_MAX_FRAMES];  // The image of each frame, with ATLAS_FLIP_X.
+} AtlasFacing;
+
+typedef struct {
+  int resource_id;
+  int num_images;
+  int num_frames;
+  int num_facings;
+  uint16_t offsets[ATLAS_MAX_IMAGES];  // Of each image, within the resource.
+  AtlasFacing facings[2];
+} SpriteAtlas;
+
+void sprite_atlas_init(SpriteAtlas *atlas, int resource_id);
+const AtlasFacing *sprite_atlas_facing(const SpriteAtlas *atlas, bool mirrored);
+BitmapWithData sprite_atlas_bwd_create(const SpriteAtlas *atlas, int image);
+BitmapWithData sprite_atlas_arena_bwd_create(const SpriteAtlas *atlas, int image);
+
+#endif  // SPRITE_ATLAS_H